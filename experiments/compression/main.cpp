@@ -0,0 +1,124 @@
+// Bytes on the wire and CPU time per response with and without compression.
+//
+// A local cpp-httplib server stands in for the RPC node: it serves synthetic
+// responses of realistic shape and compresses them if the client asks, as
+// the public nodes do. The client is SolanaRPCClient, so the numbers include
+// the decoding and parsing of the response.
+#include <SolanaAPI.hpp>
+
+#define CPPHTTPLIB_ZLIB_SUPPORT
+#include <httplib.h>
+
+#include <time.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::string randomBase58(std::mt19937_64 &rng, size_t size) {
+  static constexpr std::string_view Alphabet =
+      "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+  std::string res(size, '1');
+  for (auto &&c : res) {
+    c = Alphabet[rng() % Alphabet.size()];
+  }
+  return res;
+}
+
+/// getBlock response: random signatures, accounts from a pool (programs and
+/// popular accounts repeat in a real block).
+std::string makeBlockResponse(size_t tx_count) {
+  std::mt19937_64 rng(42);
+  std::vector<std::string> pool(tx_count);
+  for (auto &&key : pool) {
+    key = randomBase58(rng, 44);
+  }
+  std::string res = R"({"jsonrpc":"2.0","result":{"blockHeight":1,)"
+                    R"("blockTime":1700000000,"parentSlot":99,)"
+                    R"("transactions":[)";
+  for (size_t i = 0; i < tx_count; ++i) {
+    res += i == 0 ? "" : ",";
+    res += R"({"meta":{"err":null,"fee":5000,"loadedAddresses":)"
+           R"({"readonly":[],"writable":[]}},"transaction":{"message":)"
+           R"({"accountKeys":[)";
+    for (size_t j = 0; j < 6; ++j) {
+      res += j == 0 ? "\"" : ",\"";
+      // skewed: a few accounts are in most of the transactions
+      res += pool[(rng() % pool.size()) >> (rng() % 8)];
+      res += "\"";
+    }
+    res += R"(]},"signatures":[")" + randomBase58(rng, 88) + "\"]}}";
+  }
+  res += R"(]},"id":1})";
+  return res;
+}
+
+std::string makeBalanceResponse() {
+  return R"({"jsonrpc":"2.0","result":{"context":{"slot":100},)"
+         R"("value":1000000000},"id":1})";
+}
+
+int64_t threadCpuNs() {
+  timespec ts{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+template <typename CallTy>
+void bench(const char *name, bool compression, size_t N, CallTy &&call) {
+  size_t wire_bytes = 0;
+  int64_t cpu_ns = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < N; ++i) {
+    auto cpu_start = threadCpuNs();
+    auto &&res = call();
+    cpu_ns += threadCpuNs() - cpu_start;
+    if (!res.ok()) {
+      throw std::runtime_error("Request failed: " + res.error);
+    }
+    wire_bytes += res.wire_bytes;
+  }
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << name << (compression ? " compressed" : " identity  ")
+            << ": " << wire_bytes / N << " bytes, " << cpu_ns / N / 1000
+            << " us CPU, " << static_cast<int64_t>(elapsed.count()) / N
+            << " us latency\n";
+}
+
+} // namespace
+
+int main() {
+  const auto block = makeBlockResponse(2000);
+  const auto balance = makeBalanceResponse();
+
+  httplib::Server server;
+  server.Post("/", [&](const httplib::Request &req, httplib::Response &res) {
+    // compressed by the server if "Accept-Encoding" allows it
+    bool is_block = req.body.find("getBlock") != std::string::npos;
+    res.set_content(is_block ? block : balance, "application/json");
+  });
+  int port = server.bind_to_any_port("127.0.0.1");
+  std::thread server_thread([&server]() { server.listen_after_bind(); });
+
+  const std::string endpoint = "http://127.0.0.1:" + std::to_string(port);
+  std::cout << "getBlock response: " << block.size() << " bytes\n";
+  for (bool compression : {false, true}) {
+    SolanaRPCClient client(endpoint, compression);
+    bench("getBlock  ", compression, 200,
+          [&client]() { return client.getBlock(100); });
+    bench("getBalance", compression, 1000, [&client]() {
+      return client.getBalance("CsobwrE9x7qfKC23GFWPq8FMVWzVCErWh1A7C2dMBNMM");
+    });
+  }
+
+  server.stop();
+  server_thread.join();
+  return 0;
+}
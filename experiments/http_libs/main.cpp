@@ -403,19 +403,10 @@ void chosen_realization(size_t N) {
     auto &&r = cl.getBalance(PUBKEY);
     auto requestEndTime = std::chrono::high_resolution_clock::now();
 
-    if (cpr::status::is_success(r.status_code)) {
-      char *ct;
-      rapidjson::Document document;
-      if (document.ParseInsitu(r.text.data()).HasParseError())
-        throw std::runtime_error("Parsing error");
-      if (document.HasMember("result") &&
-          document["result"].HasMember("value")) {
-        balances[i] = document[U("result")][U("value")].GetUint64();
-      } else {
-        std::cerr << "Incomplete response: " << r.text << std::endl;
-      }
+    if (r.ok()) {
+      balances[i] = r.value->value;
     } else {
-      std::cerr << "Error: " << r.status_code << std::endl;
+      std::cerr << "Error: " << r.status_code << ": " << r.error << std::endl;
     }
 
     using TimerResolution = std::chrono::nanoseconds;
@@ -0,0 +1,225 @@
+#include "AdaptiveRateController.hpp"
+#include "ColumnStore.hpp"
+#include "ErrorHandler.hpp"
+#include "SolanaAPI.hpp"
+
+#include <tbb/global_control.h>
+#include <tbb/parallel_pipeline.h>
+#include <tbb/task_arena.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using ClockTy = std::chrono::steady_clock;
+
+// Transactions of one slot; empty if the slot was skipped by the leader.
+struct SlotBlock final {
+  uint64_t slot = 0;
+  bool skipped = false;
+  std::vector<columns::EncodedTransaction> transactions;
+};
+
+std::string endpoint;
+std::unique_ptr<IRateController> limit_controller;
+
+// Progress is saved every 100 slots (and on exit).
+constexpr uint64_t CheckpointInterval = 100;
+constexpr size_t MaxAttempts = 5;
+
+SlotBlock fetchBlock(uint64_t slot) {
+  // OPTIMIZATION: create client for each thread only once
+  // blocks are large and compress well
+  thread_local SolanaRPCClient client(endpoint, /*compression=*/true);
+
+  HTTPErrorHandler error_handler(MaxAttempts, client.time_scale());
+  auto &&result = error_handler.invoke([slot]() {
+    limit_controller->wait_limit_rate();
+    RatePermit permit(*limit_controller);
+    auto &&res = client.getBlock(slot);
+    permit.complete(res.feedback);
+    return res;
+  });
+
+  SlotBlock block;
+  block.slot = slot;
+  if (result.rpc_error_code == rpc::SlotSkippedError ||
+      result.rpc_error_code == rpc::LongTermStorageSlotSkippedError) {
+    block.skipped = true;
+    return block;
+  }
+  if (!result.ok()) {
+    throw std::runtime_error("getBlock(" + std::to_string(slot) +
+                             ") failed: " + result.error);
+  }
+
+  // parsing of the keys is done here, in parallel, the writer only copies
+  auto &&transactions = result.value->transactions;
+  block.transactions.resize(transactions.size());
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    auto &&src = transactions[i];
+    auto &&dst = block.transactions[i];
+    dst.slot = slot;
+    dst.fee = src.fee;
+    bool valid = columns::base58Decode(src.signature, dst.signature.data(),
+                                       dst.signature.size());
+    dst.accounts.resize(src.accounts.size());
+    for (size_t j = 0; j < src.accounts.size(); ++j) {
+      valid &= columns::base58Decode(src.accounts[j], dst.accounts[j].data(),
+                                     dst.accounts[j].size());
+    }
+    if (!valid) {
+      throw std::runtime_error("invalid key in slot " + std::to_string(slot));
+    }
+  }
+  return block;
+}
+
+int ingest(uint64_t first_slot, uint64_t last_slot, const std::string &dir,
+           size_t max_in_flight) {
+  columns::ColumnStoreWriter writer(dir);
+  uint64_t next_slot = writer.resume_slot().value_or(first_slot);
+  if (next_slot > first_slot) {
+    std::cout << "Resume from slot " << next_slot << std::endl;
+  }
+
+  const auto start = ClockTy::now();
+  auto last_report = start;
+  size_t blocks = 0;
+  size_t skipped = 0;
+  // the slot after the last written one
+  uint64_t written_until = next_slot;
+
+  // The fetch stage blocks its thread on the rate limit, the network and the
+  // retry waits, so the requests in flight need a thread each, not a core:
+  // the pipeline runs in its own arena of max_in_flight threads (and one for
+  // the serial stages), the TBB thread limit is raised if necessary.
+  const int concurrency = static_cast<int>(max_in_flight) + 1;
+  tbb::global_control thread_limit(
+      tbb::global_control::max_allowed_parallelism,
+      std::max(concurrency, tbb::this_task_arena::max_concurrency()));
+  tbb::task_arena arena(concurrency);
+
+  try {
+    // The number of tokens bounds the requests in flight (and the parsed
+    // blocks waiting for the writer). The writer is serial and in order, so
+    // the columns are sorted by slot.
+    arena.execute([&]() {
+      tbb::parallel_pipeline(
+          max_in_flight,
+          tbb::make_filter<void, uint64_t>(
+              tbb::filter_mode::serial_in_order,
+              [&next_slot, last_slot](tbb::flow_control &fc) -> uint64_t {
+                if (next_slot > last_slot) {
+                  fc.stop();
+                  return 0;
+                }
+                return next_slot++;
+              }) &
+              tbb::make_filter<uint64_t, SlotBlock>(
+                  tbb::filter_mode::parallel,
+                  [](uint64_t slot) { return fetchBlock(slot); }) &
+              tbb::make_filter<SlotBlock, void>(
+                  tbb::filter_mode::serial_in_order,
+                  [&](const SlotBlock &block) {
+                    for (auto &&tx : block.transactions) {
+                      writer.append(tx);
+                    }
+                    written_until = block.slot + 1;
+                    if (block.skipped) {
+                      ++skipped;
+                    } else {
+                      ++blocks;
+                    }
+                    if (written_until % CheckpointInterval == 0) {
+                      writer.checkpoint(written_until);
+                    }
+
+                    auto now = ClockTy::now();
+                    if (now - last_report >= std::chrono::seconds(10)) {
+                      std::chrono::duration<double> elapsed = now - start;
+                      std::cout << "Slot " << block.slot << ": "
+                                << blocks / elapsed.count() << " blocks/s"
+                                << std::endl;
+                      last_report = now;
+                    }
+                  }));
+    });
+  } catch (const std::exception &e) {
+    // keep everything that has been written: the next run continues from here
+    writer.checkpoint(written_until);
+    std::cerr << "Error: " << e.what() << std::endl;
+    std::cerr << "Checkpoint at slot " << written_until << std::endl;
+    return 1;
+  }
+  writer.checkpoint(written_until);
+
+  std::chrono::duration<double> elapsed = ClockTy::now() - start;
+  std::cout << "Blocks: " << blocks << ", skipped slots: " << skipped
+            << std::endl;
+  std::cout << "Transactions: " << writer.transactions()
+            << ", unique accounts: " << writer.unique_accounts() << std::endl;
+  std::cout << "Speed: " << blocks / elapsed.count() << " blocks/s"
+            << std::endl;
+  return 0;
+}
+
+// Example of a scan over the mapped columns.
+int scan(const std::string &dir) {
+  columns::MappedColumn fees(std::filesystem::path(dir) / "fee.col");
+  columns::MappedColumn accounts(std::filesystem::path(dir) / "accounts.col");
+  columns::MappedColumn dictionary(std::filesystem::path(dir) /
+                                   "accounts.dict");
+
+  size_t transactions = 0;
+  uint64_t total_fee = 0;
+  for (auto *pos = fees.begin(); pos != fees.end(); ++transactions) {
+    total_fee += readVarint(pos, fees.end());
+  }
+  size_t references = 0;
+  for (auto *pos = accounts.begin(); pos != accounts.end();) {
+    auto count = readVarint(pos, accounts.end());
+    for (uint64_t i = 0; i < count; ++i) {
+      readVarint(pos, accounts.end());
+    }
+    references += count;
+  }
+
+  std::cout << "Transactions: " << transactions << std::endl;
+  std::cout << "Total fee: " << total_fee << " lamports" << std::endl;
+  std::cout << "Account references: " << references << ", unique: "
+            << dictionary.size() / sizeof(columns::PubkeyTy) << std::endl;
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc == 3 && std::string(argv[1]) == "--scan") {
+    return scan(argv[2]);
+  }
+  if (argc < 5) {
+    std::cerr << "Usage: " << argv[0]
+              << " <endpoint> <first_slot> <last_slot> <out_dir>"
+                 " [in_flight=16] [requests_per_10s=100]\n"
+              << "       " << argv[0] << " --scan <out_dir>" << std::endl;
+    return 1;
+  }
+  endpoint = argv[1];
+  uint64_t first_slot = std::stoull(argv[2]);
+  uint64_t last_slot = std::stoull(argv[3]);
+  size_t in_flight = argc > 5 ? std::stoul(argv[5]) : 16;
+  double rate = argc > 6 ? std::stod(argv[6]) / 10 : 10;
+
+  // the adaptive controller stays inside the budget and backs off on 429
+  auto window = static_cast<double>(in_flight);
+  limit_controller = std::make_unique<AdaptiveRateController>(
+      AdaptiveRateConfig{.initial_in_flight = window,
+                         .max_in_flight = window,
+                         .initial_rate = rate,
+                         .max_rate = rate});
+  return ingest(first_slot, last_slot, argv[4], in_flight);
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "IRateController.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+/// @brief Parameters of AdaptiveRateController.
+struct AdaptiveRateConfig final {
+  double initial_in_flight = 4;
+  double min_in_flight = 1;
+  double max_in_flight = 64;
+  // requests per second
+  double initial_rate = 10;
+  double min_rate = 0.5;
+  double max_rate = 100;
+  // multiplicative decrease factor
+  double backoff = 0.5;
+  // RTT / min RTT ratio which is treated as queueing
+  double rtt_tolerance = 2.0;
+};
+
+/// @brief Rate controller that tracks the real capacity of the provider.
+///
+/// Two limits are adjusted at runtime:
+///   1. in-flight limit (concurrency window, as in TCP congestion control);
+///   2. request rate (requests per second, requests are paced evenly).
+///
+/// The control law is AIMD with a delay signal in the style of TCP Vegas:
+///   * success with RTT close to the minimal observed RTT - additive increase
+///     (+1 to the window and +1 req/s per round trip);
+///   * success with inflated RTT (the server or the network queues requests) -
+///     the window is shrunk by the ratio min_rtt / rtt;
+///   * 429, timeout, 5xx - multiplicative decrease (at most once per RTT, so a
+///     burst of 429 from one window is counted once) and a pause for
+///     "retry-after".
+/// The "x-ratelimit-rps-limit" header caps the rate, and a zero
+/// "x-ratelimit-*-remaining" stops the growth.
+class AdaptiveRateController final : public IRateController {
+public:
+  AdaptiveRateController(AdaptiveRateConfig config = AdaptiveRateConfig{})
+      : m_config(config), m_in_flight_limit(config.initial_in_flight),
+        m_rate(config.initial_rate), m_next_send(ClockTy::now()),
+        m_pause_until(m_next_send), m_last_decrease(m_next_send) {}
+
+  bool wait_limit_rate_until(ClockTy::time_point deadline) override {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto can_send = [this] { return m_in_flight < inFlightLimit(); };
+    if (deadline == ClockTy::time_point::max()) {
+      m_can_send.wait(lock, can_send);
+    } else if (!m_can_send.wait_until(lock, deadline, can_send)) {
+      return false;
+    }
+
+    // pacing: the next request is allowed one interval after the previous one
+    auto now = ClockTy::now();
+    auto send_time = std::max({now, m_next_send, m_pause_until});
+    if (send_time > deadline) {
+      // the slot stays free for a request that can still use it: pass on
+      // the wakeup, which may have been meant for this waiter
+      m_can_send.notify_one();
+      return false;
+    }
+    ++m_in_flight;
+    m_next_send = send_time + interval();
+    if (send_time > now) {
+      // sleep without the lock, the time point is already reserved
+      lock.unlock();
+      std::this_thread::sleep_until(send_time);
+    }
+    return true;
+  }
+
+  void on_response(const RateFeedback &feedback) override {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    --m_in_flight;
+    m_can_send.notify_one();
+
+    auto now = ClockTy::now();
+    if (feedback.rps_limit && *feedback.rps_limit != 0) {
+      m_rate_cap = static_cast<double>(*feedback.rps_limit);
+    }
+
+    const bool overloaded =
+        feedback.status_code == 0 || feedback.status_code == 429 ||
+        feedback.status_code >= 500;
+    if (overloaded) {
+      decrease(now, m_config.backoff, m_config.backoff);
+      if (feedback.retry_after_ms != 0) {
+        m_pause_until =
+            std::max(m_pause_until,
+                     now + std::chrono::milliseconds(feedback.retry_after_ms));
+      }
+      clamp();
+      return;
+    }
+
+    updateRtt(feedback.latency_ms);
+    const bool exhausted = feedback.remaining && *feedback.remaining == 0;
+    if (m_smoothed_rtt_ms > m_config.rtt_tolerance * m_min_rtt_ms) {
+      // requests are queued somewhere: shrink to the uncongested window
+      decrease(now, m_min_rtt_ms / m_smoothed_rtt_ms, 1.0);
+    } else if (!exhausted) {
+      // +1 per window of responses
+      m_in_flight_limit += 1.0 / m_in_flight_limit;
+      // +1 req/s per second of responses
+      m_rate += 1.0 / m_rate;
+    }
+    clamp();
+  }
+
+  size_t in_flight_limit() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return inFlightLimit();
+  }
+
+  double rate() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_rate;
+  }
+
+private:
+  size_t inFlightLimit() const {
+    return std::max<size_t>(static_cast<size_t>(m_in_flight_limit), 1);
+  }
+
+  ClockTy::duration interval() const {
+    return std::chrono::duration_cast<ClockTy::duration>(
+        std::chrono::duration<double>(1.0 / m_rate));
+  }
+
+  void decrease(ClockTy::time_point now, double window_factor,
+                double rate_factor) {
+    // one decrease per round trip: the responses of one window carry the same
+    // congestion signal
+    auto rtt =
+        std::chrono::milliseconds(static_cast<int64_t>(m_smoothed_rtt_ms));
+    if (now - m_last_decrease < rtt) {
+      return;
+    }
+    m_last_decrease = now;
+    m_in_flight_limit *= window_factor;
+    m_rate *= rate_factor;
+  }
+
+  void updateRtt(int64_t latency_ms) {
+    auto rtt = static_cast<double>(std::max<int64_t>(latency_ms, 1));
+    m_min_rtt_ms = std::min(m_min_rtt_ms, rtt);
+    // EWMA as in TCP (RFC 6298)
+    m_smoothed_rtt_ms =
+        m_smoothed_rtt_ms == 0 ? rtt : 0.875 * m_smoothed_rtt_ms + 0.125 * rtt;
+  }
+
+  void clamp() {
+    m_in_flight_limit = std::clamp(m_in_flight_limit, m_config.min_in_flight,
+                                   m_config.max_in_flight);
+    m_rate = std::clamp(m_rate, m_config.min_rate,
+                        std::max(std::min(m_config.max_rate, m_rate_cap),
+                                 m_config.min_rate));
+  }
+
+  const AdaptiveRateConfig m_config;
+  double m_in_flight_limit = 0;
+  double m_rate = 0;
+  // rate limit reported by the provider
+  double m_rate_cap = std::numeric_limits<double>::max();
+  size_t m_in_flight = 0;
+
+  double m_min_rtt_ms = std::numeric_limits<double>::max();
+  double m_smoothed_rtt_ms = 0;
+
+  ClockTy::time_point m_next_send;
+  ClockTy::time_point m_pause_until;
+  ClockTy::time_point m_last_decrease;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_can_send;
+};
@@ -0,0 +1,280 @@
+#pragma once
+
+#include "Varint.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/// Columnar on-disk storage of transactions.
+///
+/// A store is a directory with one file per column:
+///   slot.col      - slot of each transaction, delta from the previous one,
+///                   varint (mostly one zero byte);
+///   fee.col       - fee in lamports, varint;
+///   signature.col - the first signature, 64 raw bytes (instead of 88 base58
+///                   characters), so it is randomly accessible;
+///   accounts.col  - per transaction: number of accounts and their ids in the
+///                   dictionary, varints;
+///   accounts.dict - unique account keys, 32 raw bytes each.
+/// The files are append-only and can be memory-mapped for scans
+/// (MappedColumn). Progress is saved in a checkpoint file: on restart the
+/// columns are truncated to the checkpointed sizes, so a crash between
+/// checkpoints loses nothing but the work after the last checkpoint.
+namespace columns {
+
+using SignatureTy = std::array<uint8_t, 64>;
+using PubkeyTy = std::array<uint8_t, 32>;
+
+/// @brief Decode base58 string \p str into exactly \p size bytes.
+/// @return false if \p str is not base58 or doesn't fit.
+inline bool base58Decode(std::string_view str, uint8_t *out, size_t size) {
+  static constexpr std::string_view Alphabet =
+      "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+  std::fill(out, out + size, 0);
+  for (char c : str) {
+    auto digit = Alphabet.find(c);
+    if (digit == std::string_view::npos) {
+      return false;
+    }
+    // out = out * 58 + digit (big-endian)
+    uint32_t carry = static_cast<uint32_t>(digit);
+    for (size_t i = size; i-- > 0;) {
+      carry += static_cast<uint32_t>(out[i]) * 58;
+      out[i] = static_cast<uint8_t>(carry & 0xff);
+      carry >>= 8;
+    }
+    if (carry != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// @brief Transaction prepared for writing: keys are decoded already.
+struct EncodedTransaction final {
+  uint64_t slot = 0;
+  SignatureTy signature{};
+  uint64_t fee = 0;
+  std::vector<PubkeyTy> accounts;
+};
+
+/// @brief Append-only writer of a column store with checkpoints.
+///
+/// NOTE: the writer is not thread-safe, it is the serial stage of a pipeline.
+class ColumnStoreWriter final {
+public:
+  ColumnStoreWriter(std::filesystem::path dir) : m_dir(std::move(dir)) {
+    std::filesystem::create_directories(m_dir);
+    loadCheckpoint();
+    for (size_t i = 0; i < ColumnCount; ++i) {
+      auto &&path = m_dir / ColumnNames[i];
+      if (!std::filesystem::exists(path)) {
+        std::ofstream(path, std::ios::binary);
+      }
+      // drop everything written after the checkpoint
+      std::filesystem::resize_file(path, m_sizes[i]);
+      m_files[i].open(path, std::ios::binary | std::ios::app);
+      if (!m_files[i]) {
+        throw std::runtime_error("can't open column " + path.string());
+      }
+    }
+    loadDictionary();
+  }
+
+  /// @return the slot to continue from, if the store is not empty.
+  std::optional<uint64_t> resume_slot() const { return m_next_slot; }
+
+  void append(const EncodedTransaction &tx) {
+    putVarint(Slot, tx.slot - m_prev_slot);
+    m_prev_slot = tx.slot;
+    putVarint(Fee, tx.fee);
+    put(Signature, tx.signature.data(), tx.signature.size());
+    putVarint(Accounts, tx.accounts.size());
+    for (auto &&account : tx.accounts) {
+      putVarint(Accounts, accountId(account));
+    }
+    ++m_transactions;
+  }
+
+  /// @brief Make everything appended so far durable. The next run starts
+  /// from \p next_slot.
+  ///
+  /// The columns reach the disk before the checkpoint that refers to them,
+  /// and the checkpoint - before it replaces the old one. Otherwise after a
+  /// power loss the checkpoint may point past the end of a column.
+  void checkpoint(uint64_t next_slot) {
+    for (size_t i = 0; i < ColumnCount; ++i) {
+      if (!m_files[i].flush()) {
+        throw std::runtime_error("can't write column " +
+                                 std::string(ColumnNames[i]));
+      }
+      sync(m_dir / ColumnNames[i]);
+    }
+    m_next_slot = next_slot;
+
+    // write-then-rename: the checkpoint is replaced atomically
+    auto &&tmp = m_dir / "checkpoint.tmp";
+    {
+      std::ofstream out(tmp, std::ios::trunc);
+      out << "next_slot " << next_slot << "\n"
+          << "prev_slot " << m_prev_slot << "\n"
+          << "transactions " << m_transactions << "\n";
+      for (size_t i = 0; i < ColumnCount; ++i) {
+        out << ColumnNames[i] << " " << m_sizes[i] << "\n";
+      }
+      if (!out.flush()) {
+        throw std::runtime_error("can't write checkpoint");
+      }
+    }
+    sync(tmp);
+    std::filesystem::rename(tmp, m_dir / "checkpoint");
+    // the rename itself is durable when the directory is
+    sync(m_dir);
+  }
+
+  uint64_t transactions() const { return m_transactions; }
+  size_t unique_accounts() const { return m_dictionary.size(); }
+
+private:
+  enum ColumnIdx { Slot, Fee, Signature, Accounts, Dictionary, ColumnCount };
+  static constexpr std::array<const char *, ColumnCount> ColumnNames = {
+      "slot.col", "fee.col", "signature.col", "accounts.col", "accounts.dict"};
+
+  struct PubkeyHash final {
+    size_t operator()(const PubkeyTy &key) const {
+      // keys are uniformly distributed: any 8 bytes are a good hash
+      size_t res = 0;
+      std::copy_n(key.data(), sizeof(res), reinterpret_cast<uint8_t *>(&res));
+      return res;
+    }
+  };
+
+  /// fsync of a file or a directory. The page cache belongs to the file, so
+  /// any descriptor of it will do: the streams don't expose theirs.
+  static void sync(const std::filesystem::path &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0 || fsync(fd) != 0) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      throw std::runtime_error("can't sync " + path.string());
+    }
+    close(fd);
+  }
+
+  void put(ColumnIdx column, const uint8_t *data, size_t size) {
+    m_files[column].write(reinterpret_cast<const char *>(data), size);
+    m_sizes[column] += size;
+  }
+
+  void putVarint(ColumnIdx column, uint64_t value) {
+    uint8_t buf[MaxVarintSize];
+    put(column, buf, encodeVarint(value, buf));
+  }
+
+  uint64_t accountId(const PubkeyTy &account) {
+    auto [it, inserted] =
+        m_dictionary.try_emplace(account, m_dictionary.size());
+    if (inserted) {
+      put(Dictionary, account.data(), account.size());
+    }
+    return it->second;
+  }
+
+  void loadCheckpoint() {
+    std::ifstream in(m_dir / "checkpoint");
+    if (!in) {
+      return;
+    }
+    std::map<std::string, uint64_t> values;
+    std::string key;
+    uint64_t value = 0;
+    while (in >> key >> value) {
+      values[key] = value;
+    }
+    m_next_slot = values["next_slot"];
+    m_prev_slot = values["prev_slot"];
+    m_transactions = values["transactions"];
+    for (size_t i = 0; i < ColumnCount; ++i) {
+      m_sizes[i] = values[ColumnNames[i]];
+    }
+  }
+
+  void loadDictionary() {
+    std::ifstream in(m_dir / ColumnNames[Dictionary], std::ios::binary);
+    PubkeyTy key;
+    while (in.read(reinterpret_cast<char *>(key.data()), key.size())) {
+      m_dictionary.try_emplace(key, m_dictionary.size());
+    }
+  }
+
+  std::filesystem::path m_dir;
+  std::array<std::ofstream, ColumnCount> m_files;
+  // bytes written to each column (checkpointed ones after a checkpoint)
+  std::array<uint64_t, ColumnCount> m_sizes{};
+
+  std::optional<uint64_t> m_next_slot;
+  uint64_t m_prev_slot = 0;
+  uint64_t m_transactions = 0;
+  std::unordered_map<PubkeyTy, uint64_t, PubkeyHash> m_dictionary;
+};
+
+/// @brief Read-only memory mapping of a column file.
+class MappedColumn final {
+public:
+  MappedColumn(const std::filesystem::path &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("can't open column " + path.string());
+    }
+    struct stat st {};
+    fstat(fd, &st);
+    m_size = static_cast<size_t>(st.st_size);
+    if (m_size != 0) {
+      void *ptr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("can't map column " + path.string());
+      }
+      m_data = static_cast<const uint8_t *>(ptr);
+      // columns are scanned sequentially
+      madvise(ptr, m_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+  }
+
+  MappedColumn(const MappedColumn &) = delete;
+  MappedColumn &operator=(const MappedColumn &) = delete;
+
+  ~MappedColumn() {
+    if (m_data != nullptr) {
+      munmap(const_cast<uint8_t *>(m_data), m_size);
+    }
+  }
+
+  const uint8_t *begin() const { return m_data; }
+  const uint8_t *end() const { return m_data + m_size; }
+  size_t size() const { return m_size; }
+
+private:
+  const uint8_t *m_data = nullptr;
+  size_t m_size = 0;
+};
+
+} // namespace columns
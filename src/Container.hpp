@@ -1,8 +1,28 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
+#include <iterator>
 #include <list>
+#include <memory_resource>
 #include <mutex>
+#include <tuple>
+
+/// @brief Retention policy for ConcurrentContainer.
+///
+/// Every limit equal to 0 is disabled. When any limit is exceeded, the oldest
+/// entries are evicted in batches of at least \p eviction_batch elements, so
+/// the cost of eviction is amortized over many insertions.
+struct RetentionPolicy final {
+  // maximum number of stored entries
+  size_t max_entries = 0;
+  // maximum distance between the newest and the oldest stored key (slot)
+  size_t max_key_age = 0;
+  // approximate memory budget for stored entries (list nodes)
+  size_t max_bytes = 0;
+  // minimum number of elements evicted at once
+  size_t eviction_batch = 64;
+};
 
 /// A container for storing the results in parallel, maintaining a key-sorted
 /// order. The container is designed with the expectation of temporary locality
@@ -18,11 +38,28 @@
 /// Other interesting implementations:
 ///    1. skip list - O(logN) insertion but without blocking entire container.
 ///    2. Priority queue - O(logN) insertion
+///
+/// Memory is bounded by RetentionPolicy. List nodes are allocated from a pool
+/// resource, so nodes of evicted entries are reused by the next insertions
+/// and a long-running process does not touch the global heap in steady state.
 template <typename KeyTy, typename ValTy> class ConcurrentContainer final {
+public:
   using DataTy = std::tuple<KeyTy, size_t, ValTy>;
-  std::list<DataTy> m_data;
+
+private:
+  // approximate size of one list node: value and two links
+  static constexpr size_t NodeSize = sizeof(DataTy) + 2 * sizeof(void *);
+
+  // NOTE: the pool must be declared (constructed) before the list.
+  std::pmr::unsynchronized_pool_resource m_node_pool;
+  std::pmr::list<DataTy> m_data;
   mutable std::mutex m_access_mutex;
 
+  RetentionPolicy m_retention;
+  // max_entries and max_bytes reduced to one limit on the number of entries
+  size_t m_max_entries = 0;
+  size_t m_evicted_count = 0;
+
   // task 3
   // FIXME: it is better to separate responsibilities
   //=----------------------------------------------------------------
@@ -34,34 +71,40 @@ template <typename KeyTy, typename ValTy> class ConcurrentContainer final {
   // T
   size_t m_window_width = 0;
   // <key, latency, value>
-  std::list<DataTy>::const_iterator m_window_left_it;
+  std::pmr::list<DataTy>::const_iterator m_window_left_it;
 
 public:
-  ConcurrentContainer(size_t window_width = 2)
-      : m_window_width(window_width), m_window_left_it(m_data.end()) {}
+  ConcurrentContainer(size_t window_width = 2,
+                      RetentionPolicy retention = RetentionPolicy{})
+      : m_data(&m_node_pool), m_retention(retention),
+        m_max_entries(entries_limit(retention)),
+        m_window_width(window_width), m_window_left_it(m_data.end()) {}
 
   template <typename KeyTy2, typename ValTy2>
   void emplace_back(KeyTy2 &&key, ValTy2 &&val, size_t latency) {
     std::lock_guard<std::mutex> lock(m_access_mutex);
-    // find position by Key and insert
-    auto &&posIt = m_data.end();
+    // find position by Key and insert: before the newer elements, at the
+    // front if all of them are newer (retention relies on the order)
+    auto posIt = m_data.end();
     bool insert_inside_window = true;
     while (posIt != m_data.begin()) {
-      --posIt;
-      if (std::get<0>(*posIt) <= key) {
+      auto prevIt = std::prev(posIt);
+      if (std::get<0>(*prevIt) <= key) {
         break;
       }
-      if (posIt == m_window_left_it) {
+      if (prevIt == m_window_left_it) {
         insert_inside_window = false;
       }
+      posIt = prevIt;
     }
-    m_data.emplace(++posIt, std::forward<KeyTy2>(key), latency,
+    m_data.emplace(posIt, std::forward<KeyTy2>(key), latency,
                    std::forward<ValTy2>(val));
 
     if (insert_inside_window) {
       add_to_window(latency);
       shift_window();
     }
+    enforce_retention();
   }
 
   auto size() const {
@@ -69,6 +112,12 @@ public:
     return m_data.size();
   }
 
+  /// @return number of entries evicted by the retention policy.
+  size_t evicted_count() const {
+    std::lock_guard<std::mutex> lock(m_access_mutex);
+    return m_evicted_count;
+  }
+
   DataTy top_newer() {
     std::lock_guard<std::mutex> lock(m_access_mutex);
     return m_data.back();
@@ -85,13 +134,8 @@ public:
       return false;
     }
     Res = m_data.front();
-
-    // we should delete element from window if necessary
-    if (m_window_left_it == m_data.begin()) {
-      auto cur_latency = m_window_left_it->second;
-      delete_from_window(cur_latency);
-      ++m_window_left_it;
-    }
+    erase_older();
+    return true;
   }
 
   // task 3
@@ -122,6 +166,54 @@ private:
     m_window_square_sum -= latency * latency;
   }
 
+  /// Remove the oldest element, keeping the window consistent.
+  void erase_older() {
+    // we should delete element from window if necessary
+    if (m_window_left_it == m_data.begin()) {
+      auto cur_latency = std::get<1>(*m_window_left_it);
+      delete_from_window(cur_latency);
+      ++m_window_left_it;
+    }
+    m_data.pop_front();
+  }
+
+  static size_t entries_limit(const RetentionPolicy &retention) {
+    size_t limit = retention.max_entries;
+    if (retention.max_bytes != 0) {
+      auto bytes_limit = std::max<size_t>(retention.max_bytes / NodeSize, 1);
+      limit = limit == 0 ? bytes_limit : std::min(limit, bytes_limit);
+    }
+    return limit;
+  }
+
+  void enforce_retention() {
+    size_t to_evict = 0;
+    if (m_max_entries != 0 && m_data.size() > m_max_entries) {
+      // evict a whole batch to amortize eviction over many insertions
+      to_evict =
+          std::max(m_data.size() - m_max_entries,
+                   std::min(m_retention.eviction_batch, m_max_entries / 2));
+    }
+    if (m_retention.max_key_age != 0) {
+      const auto newest = std::get<0>(m_data.back());
+      // front keys are checked first, so the scan stops at the first young one
+      if (newest - std::get<0>(m_data.front()) > m_retention.max_key_age) {
+        to_evict = std::max<size_t>(to_evict, 1);
+        auto it = std::next(m_data.begin(), to_evict);
+        while (it != m_data.end() &&
+               newest - std::get<0>(*it) > m_retention.max_key_age) {
+          ++it;
+          ++to_evict;
+        }
+      }
+    }
+    to_evict = std::min(to_evict, m_data.size());
+    for (size_t i = 0; i < to_evict; ++i) {
+      erase_older();
+    }
+    m_evicted_count += to_evict;
+  }
+
   void shift_window() {
     if (m_data.empty()) {
       return;
@@ -1,8 +1,6 @@
 #pragma once
 
-#include "cpr/response.h"
 #include "cpr/status_codes.h"
-#include <cpr/cpr.h>
 
 #include <chrono>
 #include <thread>
@@ -11,12 +9,18 @@
 class HTTPErrorHandler final {
   size_t m_attempt_count = 0;
   size_t m_max_attempts_count = 0;
+  double m_time_scale = 1.0;
 
 public:
-  HTTPErrorHandler(size_t max_attempts)
-      : m_attempt_count(0), m_max_attempts_count(max_attempts) {}
-
-  template <typename FTy> cpr::Response invoke(FTy &&F) {
+  /// @param time_scale factor of the waits between attempts, e.g. 0.1 for a
+  /// transport replaying traffic 10 times faster (ITransport::time_scale).
+  HTTPErrorHandler(size_t max_attempts, double time_scale = 1.0)
+      : m_attempt_count(0), m_max_attempts_count(max_attempts),
+        m_time_scale(time_scale) {}
+
+  /// @brief Call \p F until it succeeds or the attempts are over.
+  /// \p F returns rpc::RpcResult.
+  template <typename FTy> auto invoke(FTy &&F) -> decltype(F()) {
     auto &&r = F();
 
     if (m_attempt_count >= m_max_attempts_count) {
@@ -30,18 +34,26 @@ public:
     if (r.status_code == 0) {
       // probably timeout
       ++m_attempt_count;
-      std::this_thread::sleep_for(std::chrono::seconds(5));
+      sleep(std::chrono::seconds(5));
       return invoke(std::forward<FTy>(F));
     }
 
     if (r.status_code == cpr::status::HTTP_TOO_MANY_REQUESTS) {
       ++m_attempt_count;
 
-      size_t sleep_sec = std::stoi(r.header["retry-after"]);
-      std::this_thread::sleep_for(std::chrono::seconds(sleep_sec));
+      // wait at least a second if the server doesn't tell how long
+      size_t sleep_ms =
+          r.feedback.retry_after_ms != 0 ? r.feedback.retry_after_ms : 1000;
+      sleep(std::chrono::milliseconds(sleep_ms));
       return invoke(std::forward<FTy>(F));
     }
     // there are many more interesting errors that can be handled here
     return r;
   }
-};
\ No newline at end of file
+
+private:
+  template <typename DurationTy> void sleep(DurationTy duration) const {
+    std::this_thread::sleep_for(
+        std::chrono::duration<double>(duration) * m_time_scale);
+  }
+};
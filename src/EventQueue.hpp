@@ -0,0 +1,300 @@
+#pragma once
+
+#include "IEventHandler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+/// @brief What to do with a new event when the queue is full.
+enum class OverflowPolicy {
+  // block the producer until a consumer takes an event
+  BLOCK,
+  // discard the oldest queued event of the least urgent class
+  DROP_OLDEST,
+  // discard a NOTHING event (queued or incoming), block if there is none
+  DROP_NOTHING_FIRST,
+};
+
+/// @brief How consumers choose the class of the next event.
+enum class SchedulingPolicy {
+  // smooth weighted round robin over non-empty classes
+  WEIGHTED_FAIR,
+  // the class whose head has the earliest deadline
+  EARLIEST_DEADLINE,
+};
+
+/// @brief Counters of the event queue. All values are monotonic except depth.
+struct EventQueueStats final {
+  size_t depth = 0;
+  size_t max_depth = 0;
+  size_t pushed = 0;
+  size_t dropped = 0;
+  size_t coalesced = 0;
+  // events whose deadline passed before they were dispatched
+  size_t expired = 0;
+  std::array<size_t, EventPriorityCount> dispatched{};
+};
+
+/// @brief Bounded MPMC queue of events between the producer and the handler
+/// pool.
+///
+/// The queue decouples the event stream from the workers: when the producer
+/// outpaces the handlers, the backlog is bounded by \p capacity and the
+/// overflow is resolved by OverflowPolicy. Additionally, duplicate INVOKE
+/// events may be coalesced: an INVOKE that arrives while another INVOKE of
+/// the same class is still waiting in the queue gives no new information
+/// (both would request the same balance), so it is counted and discarded.
+///
+/// The queue is also the scheduler of the handler pool. Every priority class
+/// has its own FIFO lane, and pop() takes the next event according to
+/// SchedulingPolicy, so a burst of BULK events can't starve CRITICAL ones.
+/// The number of dispatched but not completed events (in-flight slots) may be
+/// limited: a consumer calls complete() when the event is handled. Since the
+/// handlers take rate limit tokens right after pop(), the tokens are shared
+/// between classes in the same proportion. Expired events are dropped here,
+/// before they reach the rate limiter.
+///
+/// NOTE: EARLIEST_DEADLINE compares lane heads only. Events of one class
+/// usually have the same relative deadline, so each lane is (almost) sorted by
+/// deadline already.
+///
+/// Area for improvement: a lock-free ring buffer. The mutex is not a
+/// bottleneck here since each event costs a network round trip.
+class BoundedEventQueue final {
+public:
+  using WeightsTy = std::array<size_t, EventPriorityCount>;
+
+  BoundedEventQueue(
+      size_t capacity, OverflowPolicy policy = OverflowPolicy::BLOCK,
+      bool coalesce_invokes = false,
+      SchedulingPolicy scheduling = SchedulingPolicy::WEIGHTED_FAIR,
+      WeightsTy weights = {8, 4, 1}, size_t max_in_flight = 0)
+      : m_capacity(std::max<size_t>(capacity, 1)), m_policy(policy),
+        m_coalesce_invokes(coalesce_invokes), m_scheduling(scheduling),
+        m_weights(weights), m_max_in_flight(max_in_flight) {
+    for (auto &&weight : m_weights) {
+      weight = std::max<size_t>(weight, 1);
+    }
+  }
+
+  /// @brief Enqueue the event according to the overflow policy.
+  /// @return false if the event was not enqueued (dropped, coalesced or the
+  /// queue is closed).
+  bool push(const Event &event) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_closed) {
+      return false;
+    }
+    ++m_pushed;
+
+    auto &&lane = m_lanes[laneIdx(event)];
+    if (m_coalesce_invokes && event.type == EventTy::INVOKE &&
+        lane.queued_invokes != 0) {
+      ++m_coalesced;
+      return false;
+    }
+
+    if (m_size >= m_capacity && !makeRoom(lock, event)) {
+      ++m_dropped;
+      return false;
+    }
+    if (m_closed) {
+      return false;
+    }
+
+    lane.events.push_back(event);
+    if (event.type == EventTy::INVOKE) {
+      ++lane.queued_invokes;
+    }
+    ++m_size;
+    m_max_depth = std::max(m_max_depth, m_size);
+    m_can_pop.notify_one();
+    return true;
+  }
+
+  /// @brief Dequeue the next event according to the scheduling policy. Block
+  /// while the queue is empty or all in-flight slots are taken. Expired events
+  /// are skipped.
+  /// @return false if the queue is closed and drained.
+  bool pop(Event &event) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+      m_can_pop.wait(lock, [this] {
+        return (m_size != 0 && hasFreeSlot()) || (m_size == 0 && m_closed);
+      });
+      if (m_size == 0) {
+        return false;
+      }
+      auto &&lane = m_lanes[nextLane()];
+      event = lane.events.front();
+      eraseAt(lane, lane.events.begin());
+      m_can_push.notify_one();
+
+      if (event.expired()) {
+        ++m_expired;
+        continue;
+      }
+      ++m_in_flight;
+      ++m_dispatched[laneIdx(event)];
+      return true;
+    }
+  }
+
+  /// @brief The event returned by pop is handled, release its in-flight slot.
+  void complete() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    --m_in_flight;
+    m_can_pop.notify_one();
+  }
+
+  /// @brief No more events will be pushed. Consumers drain the queue and
+  /// then pop returns false.
+  void close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_can_pop.notify_all();
+    m_can_push.notify_all();
+  }
+
+  size_t depth() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size;
+  }
+
+  EventQueueStats stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return {m_size,      m_max_depth, m_pushed,    m_dropped,
+            m_coalesced, m_expired,   m_dispatched};
+  }
+
+private:
+  struct Lane final {
+    std::deque<Event> events;
+    // number of INVOKE events in the lane
+    size_t queued_invokes = 0;
+    // current weight of smooth weighted round robin
+    long long current_weight = 0;
+  };
+
+  static size_t laneIdx(const Event &event) {
+    return std::min(static_cast<size_t>(event.priority),
+                    EventPriorityCount - 1);
+  }
+
+  bool hasFreeSlot() const {
+    return m_max_in_flight == 0 || m_in_flight < m_max_in_flight;
+  }
+
+  /// Choose a non-empty lane. The queue must not be empty.
+  size_t nextLane() {
+    size_t best = EventPriorityCount;
+    if (m_scheduling == SchedulingPolicy::EARLIEST_DEADLINE) {
+      for (size_t i = 0; i < EventPriorityCount; ++i) {
+        if (!m_lanes[i].events.empty() &&
+            (best == EventPriorityCount ||
+             m_lanes[i].events.front().deadline <
+                 m_lanes[best].events.front().deadline)) {
+          best = i;
+        }
+      }
+      return best;
+    }
+
+    // smooth weighted round robin: every non-empty lane gains its weight, the
+    // richest one is chosen and pays the total weight.
+    long long total = 0;
+    for (size_t i = 0; i < EventPriorityCount; ++i) {
+      if (m_lanes[i].events.empty()) {
+        continue;
+      }
+      m_lanes[i].current_weight += m_weights[i];
+      total += m_weights[i];
+      if (best == EventPriorityCount ||
+          m_lanes[i].current_weight > m_lanes[best].current_weight) {
+        best = i;
+      }
+    }
+    m_lanes[best].current_weight -= total;
+    return best;
+  }
+
+  void eraseAt(Lane &lane, std::deque<Event>::iterator it) {
+    if (it->type == EventTy::INVOKE) {
+      --lane.queued_invokes;
+    }
+    lane.events.erase(it);
+    --m_size;
+    if (lane.events.empty()) {
+      // an idle class doesn't accumulate credit
+      lane.current_weight = 0;
+    }
+  }
+
+  /// Free a place for \p event. Returns false if \p event must be dropped.
+  bool makeRoom(std::unique_lock<std::mutex> &lock, const Event &event) {
+    switch (m_policy) {
+    case OverflowPolicy::DROP_OLDEST:
+      // the least urgent class is sacrificed first
+      for (size_t i = EventPriorityCount; i-- > 0;) {
+        if (!m_lanes[i].events.empty()) {
+          eraseAt(m_lanes[i], m_lanes[i].events.begin());
+          ++m_dropped;
+          break;
+        }
+      }
+      return true;
+    case OverflowPolicy::DROP_NOTHING_FIRST: {
+      if (event.type == EventTy::NOTHING) {
+        return false;
+      }
+      for (size_t i = EventPriorityCount; i-- > 0;) {
+        auto &&events = m_lanes[i].events;
+        auto it = std::find_if(events.begin(), events.end(), [](auto &&e) {
+          return e.type == EventTy::NOTHING;
+        });
+        if (it != events.end()) {
+          eraseAt(m_lanes[i], it);
+          ++m_dropped;
+          return true;
+        }
+      }
+      // only useful events are queued: apply backpressure
+      [[fallthrough]];
+    }
+    case OverflowPolicy::BLOCK:
+    default:
+      m_can_push.wait(lock,
+                      [this] { return m_size < m_capacity || m_closed; });
+      return true;
+    }
+  }
+
+  const size_t m_capacity = 0;
+  const OverflowPolicy m_policy = OverflowPolicy::BLOCK;
+  const bool m_coalesce_invokes = false;
+  const SchedulingPolicy m_scheduling = SchedulingPolicy::WEIGHTED_FAIR;
+  WeightsTy m_weights{};
+  // 0 - unlimited
+  const size_t m_max_in_flight = 0;
+
+  std::array<Lane, EventPriorityCount> m_lanes;
+  // total number of queued events
+  size_t m_size = 0;
+  size_t m_in_flight = 0;
+  bool m_closed = false;
+
+  size_t m_max_depth = 0;
+  size_t m_pushed = 0;
+  size_t m_dropped = 0;
+  size_t m_coalesced = 0;
+  size_t m_expired = 0;
+  std::array<size_t, EventPriorityCount> m_dispatched{};
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_can_pop;
+  std::condition_variable m_can_push;
+};
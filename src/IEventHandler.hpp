@@ -1,13 +1,38 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+
 enum class EventTy {
   INVOKE,
   NOTHING,
   ERROR,
 };
 
+/// @brief Priority classes of events, from the most to the least urgent.
+enum class EventPriority {
+  CRITICAL,
+  NORMAL,
+  BULK,
+};
+
+constexpr size_t EventPriorityCount = 3;
+
+struct Event final {
+  using ClockTy = std::chrono::steady_clock;
+
+  EventTy type = EventTy::NOTHING;
+  EventPriority priority = EventPriority::NORMAL;
+  // The event is useless after the deadline. No deadline by default.
+  ClockTy::time_point deadline = ClockTy::time_point::max();
+
+  bool expired(ClockTy::time_point now = ClockTy::now()) const {
+    return deadline <= now;
+  }
+};
+
 class IEventHandler {
 public:
-  virtual void handleEvent(EventTy event) = 0;
+  virtual void handleEvent(const Event &event) = 0;
   virtual ~IEventHandler() {}
 };
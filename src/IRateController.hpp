@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+/// @brief Outcome of one request as seen by a rate controller.
+struct RateFeedback final {
+  long status_code = 0;
+  int64_t latency_ms = 0;
+  // "retry-after" header, 0 if absent
+  size_t retry_after_ms = 0;
+  // "x-ratelimit-rps-limit" header: the provider's requests per second
+  std::optional<size_t> rps_limit;
+  // the smallest of "x-ratelimit-*-remaining" headers
+  std::optional<size_t> remaining;
+};
+
+/// @brief Interface of the request rate limiters.
+///
+/// Each wait_limit_rate call allows one request. A controller that adapts to
+/// the server must receive on_response for each allowed request.
+class IRateController {
+public:
+  using ClockTy = std::chrono::steady_clock;
+
+  void wait_limit_rate() { wait_limit_rate_until(ClockTy::time_point::max()); }
+
+  /// @brief Wait for a request, but not past \p deadline.
+  /// @return false if the request can't be allowed before the deadline, then
+  /// nothing is taken from the limit (and on_response is not expected).
+  virtual bool wait_limit_rate_until(ClockTy::time_point deadline) = 0;
+  virtual void on_response(const RateFeedback &) {}
+  virtual ~IRateController() {}
+};
+
+/// @brief A request allowed by a rate controller; reports its outcome once.
+///
+/// If the request ends without a response to report (e.g. the response
+/// can't be parsed and an exception unwinds the stack), the destructor
+/// reports a failed request (status 0), so an adaptive controller doesn't
+/// lose the in-flight slot.
+class RatePermit final {
+public:
+  explicit RatePermit(IRateController &controller)
+      : m_controller(&controller) {}
+
+  RatePermit(const RatePermit &) = delete;
+  RatePermit &operator=(const RatePermit &) = delete;
+
+  ~RatePermit() {
+    if (m_controller != nullptr) {
+      m_controller->on_response(RateFeedback{});
+    }
+  }
+
+  void complete(const RateFeedback &feedback) {
+    std::exchange(m_controller, nullptr)->on_response(feedback);
+  }
+
+private:
+  IRateController *m_controller = nullptr;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "IRateController.hpp"
+
 #include <atomic>
 #include <chrono>
 #include <mutex>
@@ -8,29 +10,35 @@
 /// @brief Controls limit rate.
 ///
 /// Each call wait_limit_rate consumes one limit point. If the limit is
-/// exceeded, execution is blocked until the next time window.
+/// exceeded, execution is blocked until the next time window (or fails if
+/// the window starts after the deadline).
 ///
 /// NOTE: The implemented logic is an approximation for honest saving to an
 /// array of call time points in the past.
-class LimitRateController {
+class LimitRateController final : public IRateController {
 public:
   LimitRateController(size_t time_window_size_ms, size_t max_requests)
       : m_time_window_size(time_window_size_ms), m_max_requests(max_requests),
         m_current_request_count(0),
         m_current_window_start(std::chrono::steady_clock::now()) {}
 
-  void wait_limit_rate() {
+  bool wait_limit_rate_until(ClockTy::time_point deadline) override {
     std::unique_lock<std::mutex> lock(m_mutex);
     updateWindow();
 
     while (m_current_request_count >= m_max_requests) {
+      auto next_window = m_current_window_start +
+                         std::chrono::milliseconds(m_time_window_size);
+      if (next_window > deadline) {
+        return false;
+      }
       // sleep for next time window
-      std::this_thread::sleep_for(
-          std::chrono::milliseconds(m_time_window_size));
+      std::this_thread::sleep_until(next_window);
       updateWindow();
     }
 
     ++m_current_request_count;
+    return true;
   }
 
 private:
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "IRateController.hpp"
+#include "RpcEventHandler.hpp"
+#include "ShardedSeriesStore.hpp"
+#include "SolanaAPI.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+
+/// @brief Event handler that tracks the balances of many accounts.
+///
+/// An INVOKE requests all accounts with getMultipleAccounts (in batches of
+/// the method limit) and puts a sample per account into the sharded store.
+/// All accounts of one response have the same slot and latency.
+class MultiAccountEventHandler final : public RpcEventHandler {
+  std::vector<std::string> m_pubkeys;
+  ShardedSeriesStore<size_t, size_t> &m_store;
+
+public:
+  // maximum number of accounts of one getMultipleAccounts request
+  static constexpr size_t MaxBatchSize = 100;
+
+  MultiAccountEventHandler(SolanaRPCClient client,
+                           std::vector<std::string> pubkeys,
+                           ShardedSeriesStore<size_t, size_t> &store,
+                           IRateController &lr_controller)
+      : RpcEventHandler(std::move(client), lr_controller),
+        m_pubkeys(std::move(pubkeys)), m_store(store) {}
+
+private:
+  void invoke(const Event &event) override {
+    for (size_t i = 0; i < m_pubkeys.size(); i += MaxBatchSize) {
+      invokeBatch(std::span<const std::string>(m_pubkeys).subspan(
+                      i, std::min(MaxBatchSize, m_pubkeys.size() - i)),
+                  event.deadline);
+    }
+  }
+
+  void invokeBatch(std::span<const std::string> pubkeys,
+                   Event::ClockTy::time_point deadline) {
+    int64_t latency = 0;
+    auto &&result = call(deadline, latency, [pubkeys](SolanaRPCClient &client) {
+      return client.getMultipleAccounts(pubkeys);
+    });
+    if (!result.ok()) {
+      // TODO: logging library
+      std::cerr << "Invoke error: " << result.status_code << ": "
+                << result.error << std::endl;
+      return;
+    }
+
+    auto &&accounts = result.value->value;
+    const size_t slot = result.value->slot;
+    for (size_t i = 0; i < accounts.size() && i < pubkeys.size(); ++i) {
+      // a nonexistent account has no balance
+      const size_t balance = accounts[i] ? accounts[i]->lamports : 0;
+      m_store.emplace_back(pubkeys[i], slot, balance, latency);
+    }
+  }
+};
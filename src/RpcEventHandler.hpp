@@ -0,0 +1,95 @@
+#pragma once
+
+#include "ErrorHandler.hpp"
+#include "IEventHandler.hpp"
+#include "IRateController.hpp"
+#include "SolanaAPI.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+/// @brief Base of the event handlers that make rate limited RPC requests.
+///
+/// Actions:
+/// INVOKE: Execute the requests of the handler (invoke) in the background
+/// upon receiving an INVOKE event, ensuring it does not block the main
+/// thread. NOTHING: No action is required for a NOTHING event. ERROR: Display
+/// an error message for an ERROR event but do not terminate the program.
+/// An INVOKE whose deadline passes before the rate limit allows the request
+/// (or its retry) is dropped without sending it.
+class RpcEventHandler : public IEventHandler {
+public:
+  void handleEvent(const Event &event) final {
+    switch (event.type) {
+    case EventTy::NOTHING:
+      break;
+    case EventTy::ERROR:
+      // TODO: logging library
+      std::cerr << "Event:error\n";
+      break;
+    case EventTy::INVOKE:
+      // don't waste the rate limit on a late request
+      if (event.expired()) {
+        // TODO: logging library
+        std::cerr << "Invoke error: deadline expired\n";
+        break;
+      }
+      invoke(event);
+      break;
+    default:
+      // TODO: fatal error(incorrect program) or logging library
+      std::cerr << "ERROR: unknown event!\n";
+      break;
+    }
+  }
+
+protected:
+  RpcEventHandler(SolanaRPCClient client, IRateController &lr_controller)
+      : m_client(std::move(client)), m_lr_controller(lr_controller) {}
+
+  virtual void invoke(const Event &event) = 0;
+
+  /// @brief Make \p request (SolanaRPCClient & -> rpc::RpcResult), retry it
+  /// on errors.
+  ///
+  /// Every attempt takes the rate limit and reports its outcome back, so an
+  /// adaptive controller sees each 429.
+  /// @param latency latency of the last attempt in ms.
+  template <typename RequestTy>
+  auto call(Event::ClockTy::time_point deadline, int64_t &latency,
+            RequestTy &&request) {
+    // Wrapper for latency measurement.
+    // If the request is sent several times due to errors, the delay is
+    // considered only for the last attempt.
+    auto &&wrapper = [&]() {
+      // reduce responses with 429 code
+      if (!m_lr_controller.wait_limit_rate_until(deadline)) {
+        // not sent: 408 is not retried by the error handler
+        decltype(request(m_client)) dropped;
+        dropped.status_code = cpr::status::HTTP_REQUEST_TIMEOUT;
+        dropped.error = "deadline expired";
+        return dropped;
+      }
+      RatePermit permit(m_lr_controller);
+      auto startTime = std::chrono::high_resolution_clock::now();
+      auto result = request(m_client);
+      auto endTime = std::chrono::high_resolution_clock::now();
+      latency = std::chrono::duration_cast<std::chrono::milliseconds>(endTime -
+                                                                      startTime)
+                    .count();
+      result.feedback.latency_ms = latency;
+      permit.complete(result.feedback);
+      return result;
+    };
+
+    // 5 attempts is maximum
+    HTTPErrorHandler error_handler(5, m_client.time_scale());
+    return error_handler.invoke(wrapper);
+  }
+
+  SolanaRPCClient m_client;
+  // FIXME: it is bad practice to save reference in a class (here and the
+  // result storages of the handlers).
+  IRateController &m_lr_controller;
+};
@@ -0,0 +1,487 @@
+#pragma once
+
+#include "IRateController.hpp"
+
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+/// Compile-time table of the Solana RPC methods.
+///
+/// Each method is declared once as a MethodDescriptor: its name, the types of
+/// its parameters and the type of its result. The request serializer and the
+/// result extractor are generated from these types at compile time:
+///   * the request prefix (`{"jsonrpc":"2.0","id":1,"method":"...",
+///     "params":[`) is a constexpr string;
+///   * every parameter type has its own writer (writeParam overload);
+///   * every result type has its own ResultParser specialization.
+/// So there is no runtime dispatch by the method name, and adding a method is
+/// one line if its types are already known.
+///
+/// NOTE: the response is still parsed into a rapidjson DOM, and the fields
+/// of the result are found in it by name at runtime (FindMember). The types
+/// fix which fields are read and how, not where they are.
+namespace rpc {
+
+//=------------------------------------------------------------------------
+// JSON memory
+//=------------------------------------------------------------------------
+
+/// @brief Heap allocator of rapidjson (as CrtAllocator) that counts the
+/// blocks it takes.
+///
+/// rapidjson takes the heap with std::malloc, not operator new, so all the
+/// JSON buffers of the client (the pools of the parsed document, the request
+/// buffer and the stack of its writer) take it through this allocator, and
+/// allocations() shows whether they still grow.
+class CountingAllocator final {
+public:
+  static const bool kNeedFree = true;
+
+  void *Malloc(size_t size) {
+    if (size == 0) {
+      return nullptr;
+    }
+    count();
+    return std::malloc(size);
+  }
+
+  void *Realloc(void *ptr, size_t old_size, size_t new_size) {
+    if (new_size == 0) {
+      std::free(ptr);
+      return nullptr;
+    }
+    // a grown block may be a new one
+    if (new_size > old_size) {
+      count();
+    }
+    return std::realloc(ptr, new_size);
+  }
+
+  static void Free(void *ptr) { std::free(ptr); }
+
+  /// @return the number of blocks taken or grown by all the instances.
+  static size_t allocations() {
+    return s_allocations.load(std::memory_order_relaxed);
+  }
+
+private:
+  static void count() { s_allocations.fetch_add(1, std::memory_order_relaxed); }
+
+  static inline std::atomic<size_t> s_allocations{0};
+};
+
+using JsonPoolTy = rapidjson::MemoryPoolAllocator<CountingAllocator>;
+using JsonValueTy = rapidjson::GenericValue<rapidjson::UTF8<>, JsonPoolTy>;
+using RequestBufferTy =
+    rapidjson::GenericStringBuffer<rapidjson::UTF8<>, CountingAllocator>;
+using WriterTy = rapidjson::Writer<RequestBufferTy, rapidjson::UTF8<>,
+                                   rapidjson::UTF8<>, CountingAllocator>;
+
+//=------------------------------------------------------------------------
+// Result types
+//=------------------------------------------------------------------------
+
+/// @brief Value with the slot at which the server evaluated the request.
+template <typename T> struct WithContext final {
+  uint64_t slot = 0;
+  T value{};
+};
+
+struct AccountInfo final {
+  uint64_t lamports = 0;
+  std::string owner;
+  // base64 encoded account data
+  std::string data;
+  bool executable = false;
+  uint64_t rent_epoch = 0;
+};
+
+struct SignatureInfo final {
+  std::string signature;
+  uint64_t slot = 0;
+  // the transaction failed
+  bool failed = false;
+  std::optional<int64_t> block_time;
+};
+
+struct TransactionRecord final {
+  // the first signature identifies the transaction
+  std::string signature;
+  uint64_t fee = 0;
+  bool failed = false;
+  // static account keys followed by the keys loaded from lookup tables
+  std::vector<std::string> accounts;
+};
+
+struct Block final {
+  uint64_t parent_slot = 0;
+  std::optional<int64_t> block_time;
+  std::vector<TransactionRecord> transactions;
+};
+
+/// @brief Outcome of an RPC call. The value is present only on success.
+template <typename T> struct RpcResult final {
+  // HTTP status, 0 - the request was not delivered (e.g. timeout)
+  long status_code = 0;
+  // JSON-RPC error code, 0 - no error
+  int64_t rpc_error_code = 0;
+  // transport, HTTP or JSON-RPC error message
+  std::string error;
+  // rate limit information from the response headers
+  RateFeedback feedback;
+  // size of the response body on the wire (compressed, if it was)
+  size_t wire_bytes = 0;
+  std::optional<T> value;
+
+  bool ok() const { return value.has_value(); }
+};
+
+//=------------------------------------------------------------------------
+// Parameter types
+//=------------------------------------------------------------------------
+
+/// @brief Configuration object of getAccountInfo/getMultipleAccounts.
+struct AccountConfig final {
+  std::string_view encoding = "base64";
+};
+
+/// @brief Configuration object of getSignaturesForAddress.
+struct SignaturesConfig final {
+  size_t limit = 1000;
+  // start searching backwards from this signature (if not empty)
+  std::string_view before;
+};
+
+/// @brief Configuration object of getBlock.
+struct BlockConfig final {
+  std::string_view encoding = "json";
+  std::string_view transaction_details = "full";
+  bool rewards = false;
+  // accept versioned (v0) transactions
+  uint64_t max_supported_transaction_version = 0;
+};
+
+inline void writeParam(WriterTy &w, std::string_view str) {
+  w.String(str.data(), static_cast<rapidjson::SizeType>(str.size()));
+}
+
+inline void writeParam(WriterTy &w, uint64_t num) { w.Uint64(num); }
+
+inline void writeParam(WriterTy &w, std::span<const std::string> strs) {
+  w.StartArray();
+  for (auto &&str : strs) {
+    writeParam(w, std::string_view(str));
+  }
+  w.EndArray();
+}
+
+inline void writeParam(WriterTy &w, const AccountConfig &config) {
+  w.StartObject();
+  w.Key("encoding");
+  writeParam(w, config.encoding);
+  w.EndObject();
+}
+
+inline void writeParam(WriterTy &w, const SignaturesConfig &config) {
+  w.StartObject();
+  w.Key("limit");
+  w.Uint64(config.limit);
+  if (!config.before.empty()) {
+    w.Key("before");
+    writeParam(w, config.before);
+  }
+  w.EndObject();
+}
+
+inline void writeParam(WriterTy &w, const BlockConfig &config) {
+  w.StartObject();
+  w.Key("encoding");
+  writeParam(w, config.encoding);
+  w.Key("transactionDetails");
+  writeParam(w, config.transaction_details);
+  w.Key("rewards");
+  w.Bool(config.rewards);
+  w.Key("maxSupportedTransactionVersion");
+  w.Uint64(config.max_supported_transaction_version);
+  w.EndObject();
+}
+
+//=------------------------------------------------------------------------
+// Result extractors
+//=------------------------------------------------------------------------
+
+/// @return member \p name of \p obj or nullptr (a runtime lookup by name).
+template <size_t N>
+const JsonValueTy *member(const JsonValueTy &obj, const char (&name)[N]) {
+  if (!obj.IsObject()) {
+    return nullptr;
+  }
+  auto &&it = obj.FindMember(JsonValueTy(rapidjson::StringRef(name, N - 1)));
+  return it == obj.MemberEnd() ? nullptr : &it->value;
+}
+
+template <typename T> struct ResultParser;
+
+/// @brief Extract the field \p name of \p obj into \p out.
+template <typename T, size_t N>
+bool parseMember(const JsonValueTy &obj, const char (&name)[N], T &out) {
+  auto *value = member(obj, name);
+  return value != nullptr && ResultParser<T>::parse(*value, out);
+}
+
+/// @brief An absent optional field is the same as null.
+template <typename T, size_t N>
+bool parseMember(const JsonValueTy &obj, const char (&name)[N],
+                 std::optional<T> &out) {
+  auto *value = member(obj, name);
+  if (value == nullptr) {
+    out.reset();
+    return true;
+  }
+  return ResultParser<std::optional<T>>::parse(*value, out);
+}
+
+template <> struct ResultParser<uint64_t> {
+  static bool parse(const JsonValueTy &v, uint64_t &out) {
+    if (!v.IsUint64()) {
+      return false;
+    }
+    out = v.GetUint64();
+    return true;
+  }
+};
+
+template <> struct ResultParser<int64_t> {
+  static bool parse(const JsonValueTy &v, int64_t &out) {
+    if (!v.IsInt64()) {
+      return false;
+    }
+    out = v.GetInt64();
+    return true;
+  }
+};
+
+template <> struct ResultParser<bool> {
+  static bool parse(const JsonValueTy &v, bool &out) {
+    if (!v.IsBool()) {
+      return false;
+    }
+    out = v.GetBool();
+    return true;
+  }
+};
+
+template <> struct ResultParser<std::string> {
+  static bool parse(const JsonValueTy &v, std::string &out) {
+    if (!v.IsString()) {
+      return false;
+    }
+    out.assign(v.GetString(), v.GetStringLength());
+    return true;
+  }
+};
+
+template <typename T> struct ResultParser<std::optional<T>> {
+  static bool parse(const JsonValueTy &v, std::optional<T> &out) {
+    if (v.IsNull()) {
+      out.reset();
+      return true;
+    }
+    return ResultParser<T>::parse(v, out.emplace());
+  }
+};
+
+template <typename T> struct ResultParser<std::vector<T>> {
+  static bool parse(const JsonValueTy &v, std::vector<T> &out) {
+    if (!v.IsArray()) {
+      return false;
+    }
+    out.resize(v.Size());
+    for (rapidjson::SizeType i = 0; i < v.Size(); ++i) {
+      if (!ResultParser<T>::parse(v[i], out[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+template <typename T> struct ResultParser<WithContext<T>> {
+  static bool parse(const JsonValueTy &v, WithContext<T> &out) {
+    auto *context = member(v, "context");
+    return context != nullptr && parseMember(*context, "slot", out.slot) &&
+           parseMember(v, "value", out.value);
+  }
+};
+
+template <> struct ResultParser<AccountInfo> {
+  static bool parse(const JsonValueTy &v, AccountInfo &out) {
+    // "data": ["<base64>", "base64"]
+    auto *data = member(v, "data");
+    if (data == nullptr || !data->IsArray() || data->Empty() ||
+        !ResultParser<std::string>::parse(*data->Begin(), out.data)) {
+      return false;
+    }
+    return parseMember(v, "lamports", out.lamports) &&
+           parseMember(v, "owner", out.owner) &&
+           parseMember(v, "executable", out.executable) &&
+           parseMember(v, "rentEpoch", out.rent_epoch);
+  }
+};
+
+template <> struct ResultParser<SignatureInfo> {
+  static bool parse(const JsonValueTy &v, SignatureInfo &out) {
+    auto *err = member(v, "err");
+    out.failed = err != nullptr && !err->IsNull();
+    return parseMember(v, "signature", out.signature) &&
+           parseMember(v, "slot", out.slot) &&
+           parseMember(v, "blockTime", out.block_time);
+  }
+};
+
+template <> struct ResultParser<TransactionRecord> {
+  static bool parse(const JsonValueTy &v, TransactionRecord &out) {
+    // {"meta": {"fee", "err", "loadedAddresses"},
+    //  "transaction": {"signatures", "message": {"accountKeys"}}}
+    auto *meta = member(v, "meta");
+    auto *transaction = member(v, "transaction");
+    if (meta == nullptr || transaction == nullptr) {
+      return false;
+    }
+    auto *signatures = member(*transaction, "signatures");
+    auto *message = member(*transaction, "message");
+    if (signatures == nullptr || !signatures->IsArray() ||
+        signatures->Empty() ||
+        !ResultParser<std::string>::parse(*signatures->Begin(),
+                                          out.signature) ||
+        message == nullptr ||
+        !parseMember(*message, "accountKeys", out.accounts)) {
+      return false;
+    }
+    auto *err = member(*meta, "err");
+    out.failed = err != nullptr && !err->IsNull();
+    if (auto *loaded = member(*meta, "loadedAddresses")) {
+      std::vector<std::string> keys;
+      for (auto *kind :
+           {member(*loaded, "writable"), member(*loaded, "readonly")}) {
+        if (kind != nullptr &&
+            ResultParser<std::vector<std::string>>::parse(*kind, keys)) {
+          out.accounts.insert(out.accounts.end(), keys.begin(), keys.end());
+        }
+      }
+    }
+    return parseMember(*meta, "fee", out.fee);
+  }
+};
+
+template <> struct ResultParser<Block> {
+  static bool parse(const JsonValueTy &v, Block &out) {
+    return parseMember(v, "parentSlot", out.parent_slot) &&
+           parseMember(v, "blockTime", out.block_time) &&
+           parseMember(v, "transactions", out.transactions);
+  }
+};
+
+//=------------------------------------------------------------------------
+// Method descriptors
+//=------------------------------------------------------------------------
+
+/// @brief String literal usable as a template argument.
+template <size_t N> struct FixedString final {
+  char data[N]{};
+  constexpr FixedString(const char (&str)[N]) { std::copy_n(str, N, data); }
+  constexpr std::string_view view() const { return {data, N - 1}; }
+};
+
+/// @brief `{"jsonrpc":"2.0","id":1,"method":"<Name>","params":[`
+template <FixedString Name> constexpr auto makeRequestPrefix() {
+  constexpr std::string_view head = R"({"jsonrpc":"2.0","id":1,"method":")";
+  constexpr std::string_view tail = R"(","params":[)";
+  constexpr std::string_view name = Name.view();
+  std::array<char, head.size() + name.size() + tail.size()> res{};
+  auto it = std::copy(head.begin(), head.end(), res.begin());
+  it = std::copy(name.begin(), name.end(), it);
+  std::copy(tail.begin(), tail.end(), it);
+  return res;
+}
+
+template <FixedString Name>
+inline constexpr auto RequestPrefix = makeRequestPrefix<Name>();
+
+template <FixedString Name, typename ResultT, typename... ParamTs>
+struct MethodDescriptor final {
+  static constexpr std::string_view name = Name.view();
+  using ResultTy = ResultT;
+  using ParamsTy = std::tuple<ParamTs...>;
+
+  /// @brief Serialize the request into \p sb.
+  /// @param w writer of the parameters, reset to \p sb for each of them.
+  static void writeRequest(RequestBufferTy &sb, WriterTy &w,
+                           const ParamsTy &params) {
+    for (char c : RequestPrefix<Name>) {
+      sb.Put(c);
+    }
+    std::apply(
+        [&sb, &w](const auto &...param) {
+          [[maybe_unused]] bool first = true;
+          (writeNext(sb, w, first, param), ...);
+        },
+        params);
+    sb.Put(']');
+    sb.Put('}');
+  }
+
+  static bool parseResult(const JsonValueTy &v, ResultTy &out) {
+    return ResultParser<ResultTy>::parse(v, out);
+  }
+
+private:
+  template <typename ParamTy>
+  static void writeNext(RequestBufferTy &sb, WriterTy &w, bool &first,
+                        const ParamTy &param) {
+    if (!first) {
+      sb.Put(',');
+    }
+    first = false;
+    // one writer may write only one root value
+    w.Reset(sb);
+    writeParam(w, param);
+  }
+};
+
+using GetBalance =
+    MethodDescriptor<"getBalance", WithContext<uint64_t>, std::string_view>;
+using GetSlot = MethodDescriptor<"getSlot", uint64_t>;
+using GetBlockHeight = MethodDescriptor<"getBlockHeight", uint64_t>;
+using GetTransactionCount = MethodDescriptor<"getTransactionCount", uint64_t>;
+using GetAccountInfo =
+    MethodDescriptor<"getAccountInfo", WithContext<std::optional<AccountInfo>>,
+                     std::string_view, AccountConfig>;
+using GetMultipleAccounts =
+    MethodDescriptor<"getMultipleAccounts",
+                     WithContext<std::vector<std::optional<AccountInfo>>>,
+                     std::span<const std::string>, AccountConfig>;
+using GetBlock = MethodDescriptor<"getBlock", Block, uint64_t, BlockConfig>;
+using GetSignaturesForAddress =
+    MethodDescriptor<"getSignaturesForAddress", std::vector<SignatureInfo>,
+                     std::string_view, SignaturesConfig>;
+
+/// JSON-RPC error codes of getBlock for slots without a block.
+constexpr int64_t SlotSkippedError = -32007;
+constexpr int64_t LongTermStorageSlotSkippedError = -32009;
+
+} // namespace rpc
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/// @brief Windowed statistics of one series or of several series together.
+///
+/// Latency: count, sum and sum of squares (as in ConcurrentContainer), so the
+/// statistics of several series are the sums of their fields.
+/// Balance delta: the newest balance minus the oldest one in the window.
+struct WindowAggregate final {
+  size_t count = 0;
+  uint64_t latency_sum = 0;
+  uint64_t latency_square_sum = 0;
+  int64_t balance_delta = 0;
+
+  double mean_latency() const {
+    return count == 0 ? 0.0 : static_cast<double>(latency_sum) / count;
+  }
+
+  double standard_deviation() const {
+    if (count == 0) {
+      return 0.0;
+    }
+    auto mean = mean_latency();
+    return std::sqrt(
+        std::max(static_cast<double>(latency_square_sum) / count - mean * mean,
+                 0.0));
+  }
+
+  WindowAggregate &operator+=(const WindowAggregate &other) {
+    count += other.count;
+    latency_sum += other.latency_sum;
+    latency_square_sum += other.latency_square_sum;
+    balance_delta += other.balance_delta;
+    return *this;
+  }
+
+  WindowAggregate &operator-=(const WindowAggregate &other) {
+    count -= other.count;
+    latency_sum -= other.latency_sum;
+    latency_square_sum -= other.latency_square_sum;
+    balance_delta -= other.balance_delta;
+    return *this;
+  }
+};
+
+/// A store of many result series, one per account (pubkey).
+///
+/// One ConcurrentContainer per account means thousands of separately locked
+/// lists, one container for all accounts - a single contended lock. Here the
+/// accounts are spread over shards by the hash of the pubkey (lock
+/// striping): threads that update different accounts rarely meet on one
+/// mutex.
+///
+/// Each series is a ring buffer in one contiguous array, which grows up to
+/// a fixed capacity (then the oldest samples are overwritten), sorted by key
+/// with the same assumption of temporal locality as ConcurrentContainer: a
+/// sample is inserted near the end. Each series keeps the aggregate of its
+/// window (the last \p window_width keys), and each shard keeps the sum of
+/// the aggregates of its series, updated together with them. So the
+/// aggregate across all accounts takes O(shards), not O(accounts).
+template <typename KeyTy, typename ValTy> class ShardedSeriesStore final {
+  static_assert(std::is_arithmetic_v<KeyTy> && std::is_arithmetic_v<ValTy>,
+                "keys and values must be numbers");
+
+public:
+  // <key, latency, value> as in ConcurrentContainer
+  using DataTy = std::tuple<KeyTy, size_t, ValTy>;
+
+  /// @param window_width width of the window in keys (slots).
+  /// @param series_capacity maximum number of stored samples per account.
+  /// @param shard_count number of shards, 0 - by the number of cores.
+  ShardedSeriesStore(size_t window_width = 10, size_t series_capacity = 1024,
+                     size_t shard_count = 0)
+      : m_window_width(window_width),
+        m_series_capacity(std::max<size_t>(series_capacity, 1)) {
+    if (shard_count == 0) {
+      // several shards per core: two threads rarely need the same one
+      shard_count = 4 * std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    size_t count = 1;
+    while (count < shard_count) {
+      count <<= 1;
+    }
+    m_shard_mask = count - 1;
+    m_shards = std::make_unique<Shard[]>(count);
+  }
+
+  void emplace_back(std::string_view pubkey, KeyTy key, ValTy val,
+                    size_t latency) {
+    auto &&shard = shard_of(pubkey);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.series.find(pubkey);
+    if (it == shard.series.end()) {
+      it = shard.series
+               .emplace(std::string(pubkey), Series(m_series_capacity))
+               .first;
+    }
+    auto &&series = it->second;
+    shard.aggregate -= series.aggregate();
+    series.insert(DataTy(key, latency, val), m_window_width);
+    shard.aggregate += series.aggregate();
+  }
+
+  /// @return window aggregate of one account, nullopt if it is unknown.
+  std::optional<WindowAggregate>
+  series_aggregate(std::string_view pubkey) const {
+    auto &&shard = shard_of(pubkey);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.series.find(pubkey);
+    if (it == shard.series.end()) {
+      return std::nullopt;
+    }
+    return it->second.aggregate();
+  }
+
+  /// @return the newest sample of the account.
+  std::optional<DataTy> top_newer(std::string_view pubkey) const {
+    auto &&shard = shard_of(pubkey);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.series.find(pubkey);
+    if (it == shard.series.end() || it->second.size() == 0) {
+      return std::nullopt;
+    }
+    return it->second.back();
+  }
+
+  /// @brief Sum of the window aggregates of all accounts, O(shards).
+  ///
+  /// NOTE: the shards are read one by one, so the result is not a snapshot
+  /// of one moment if the store is being updated.
+  WindowAggregate aggregate() const {
+    WindowAggregate res;
+    for (size_t i = 0; i <= m_shard_mask; ++i) {
+      std::lock_guard<std::mutex> lock(m_shards[i].mutex);
+      res += m_shards[i].aggregate;
+    }
+    return res;
+  }
+
+  size_t series_count() const {
+    size_t res = 0;
+    for (size_t i = 0; i <= m_shard_mask; ++i) {
+      std::lock_guard<std::mutex> lock(m_shards[i].mutex);
+      res += m_shards[i].series.size();
+    }
+    return res;
+  }
+
+  size_t shard_count() const { return m_shard_mask + 1; }
+
+private:
+  /// Samples of one account in a ring buffer, sorted by key.
+  class Series final {
+  public:
+    // the array grows on demand: most accounts have few samples
+    Series(size_t capacity) : m_capacity(capacity) {}
+
+    size_t size() const { return m_size; }
+    const DataTy &back() const { return at(m_size - 1); }
+
+    WindowAggregate aggregate() const {
+      WindowAggregate res;
+      res.count = m_size - m_window_begin;
+      res.latency_sum = m_latency_sum;
+      res.latency_square_sum = m_latency_square_sum;
+      if (res.count != 0) {
+        auto &&oldest = at(m_window_begin);
+        res.balance_delta = static_cast<int64_t>(std::get<2>(back())) -
+                            static_cast<int64_t>(std::get<2>(oldest));
+      }
+      return res;
+    }
+
+    void insert(const DataTy &data, size_t window_width) {
+      if (m_size == m_samples.size()) {
+        if (m_samples.size() == m_capacity) {
+          evict_oldest();
+        } else {
+          grow();
+        }
+      }
+      // find position by key from the end and shift the newer samples
+      size_t pos = m_size;
+      while (pos != 0 && std::get<0>(at(pos - 1)) > std::get<0>(data)) {
+        at(pos) = at(pos - 1);
+        --pos;
+      }
+      at(pos) = data;
+      ++m_size;
+
+      if (pos >= m_window_begin) {
+        add_to_window(std::get<1>(data));
+      } else {
+        // older than the window: the window moves with its samples
+        ++m_window_begin;
+      }
+      shift_window(window_width);
+    }
+
+  private:
+    DataTy &at(size_t idx) {
+      return m_samples[(m_head + idx) % m_samples.size()];
+    }
+    const DataTy &at(size_t idx) const {
+      return m_samples[(m_head + idx) % m_samples.size()];
+    }
+
+    void add_to_window(size_t latency) {
+      m_latency_sum += latency;
+      m_latency_square_sum += static_cast<uint64_t>(latency) * latency;
+    }
+
+    void delete_from_window(size_t latency) {
+      m_latency_sum -= latency;
+      m_latency_square_sum -= static_cast<uint64_t>(latency) * latency;
+    }
+
+    /// Double the array (up to the capacity), the head moves to 0.
+    void grow() {
+      std::vector<DataTy> grown(
+          std::min(std::max<size_t>(2 * m_samples.size(), 4), m_capacity));
+      for (size_t i = 0; i < m_size; ++i) {
+        grown[i] = at(i);
+      }
+      m_samples = std::move(grown);
+      m_head = 0;
+    }
+
+    void evict_oldest() {
+      if (m_window_begin == 0) {
+        delete_from_window(std::get<1>(at(0)));
+      } else {
+        --m_window_begin;
+      }
+      m_head = (m_head + 1) % m_samples.size();
+      --m_size;
+    }
+
+    void shift_window(size_t window_width) {
+      const auto newest = std::get<0>(back());
+      while (m_window_begin != m_size &&
+             std::get<0>(at(m_window_begin)) + window_width < newest) {
+        delete_from_window(std::get<1>(at(m_window_begin)));
+        ++m_window_begin;
+      }
+    }
+
+    std::vector<DataTy> m_samples;
+    size_t m_capacity = 0;
+    size_t m_head = 0;
+    size_t m_size = 0;
+    // index of the oldest sample in the window (relative to the head)
+    size_t m_window_begin = 0;
+    uint64_t m_latency_sum = 0;
+    uint64_t m_latency_square_sum = 0;
+  };
+
+  // transparent hash: lookup by string_view without a temporary string
+  struct PubkeyHash final {
+    using is_transparent = void;
+    size_t operator()(std::string_view key) const {
+      return std::hash<std::string_view>{}(key);
+    }
+  };
+
+  // shards are updated by different threads: avoid false sharing
+  struct alignas(64) Shard final {
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Series, PubkeyHash, std::equal_to<>>
+        series;
+    // sum of the aggregates of the series
+    WindowAggregate aggregate;
+  };
+
+  Shard &shard_of(std::string_view pubkey) const {
+    return m_shards[PubkeyHash{}(pubkey) & m_shard_mask];
+  }
+
+  size_t m_window_width = 0;
+  size_t m_series_capacity = 0;
+  size_t m_shard_mask = 0;
+  std::unique_ptr<Shard[]> m_shards;
+};
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "IRateController.hpp"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+/// @brief Rate limiter shared by all processes of the host that attach with
+/// the same name.
+///
+/// Each process has its own LimitRateController, so several clients with one
+/// RPC key overshoot the provider limit together. This controller keeps the
+/// limit in a POSIX shared memory segment.
+///
+/// The limit is a token bucket implemented as GCRA (generic cell rate
+/// algorithm): the whole state is one atomic time point, the theoretical
+/// arrival time (TAT) of the next request. A request reserves its time slot
+/// with a single CAS and sleeps until the slot comes, if necessary. There are
+/// no locks, so a crashed participant can't leave the state inconsistent: at
+/// worst its reserved slots are wasted.
+///
+/// The only critical section is initialization of a new segment. The
+/// initializer publishes its pid, and if it dies before the segment is ready,
+/// the next process takes over.
+///
+/// NOTE: the parameters of the first process that initialized the segment are
+/// used by everyone. steady_clock is CLOCK_MONOTONIC on Linux, which is the
+/// same for all processes of the host.
+class SharedMemoryRateController final : public IRateController {
+public:
+  /// @param name shared memory object name, e.g. "/solana_rpc_limit".
+  /// @param time_window_size_ms window of the limit.
+  /// @param max_requests maximum number of requests per window.
+  /// @param burst number of requests that may be sent at once (default is
+  /// one: the requests are paced evenly).
+  ///
+  /// The bucket refills one request per interval. A window may take the
+  /// whole burst and the refill within the window, so the interval is
+  /// window / (max_requests - burst + 1): any window has at most
+  /// max_requests.
+  SharedMemoryRateController(std::string name, size_t time_window_size_ms,
+                             size_t max_requests, size_t burst = 1)
+      : m_name(std::move(name)) {
+    if (max_requests == 0) {
+      throw std::invalid_argument("max_requests must be positive");
+    }
+    if (burst == 0 || burst > max_requests) {
+      throw std::invalid_argument("burst must be in [1, max_requests]");
+    }
+    const int64_t interval_ns = static_cast<int64_t>(time_window_size_ms) *
+                                1000000 / (max_requests - burst + 1);
+
+    attach();
+    initialize(std::max<int64_t>(interval_ns, 1),
+               static_cast<int64_t>(burst - 1) * interval_ns);
+  }
+
+  SharedMemoryRateController(const SharedMemoryRateController &) = delete;
+  SharedMemoryRateController &
+  operator=(const SharedMemoryRateController &) = delete;
+
+  ~SharedMemoryRateController() {
+    if (m_state != nullptr) {
+      munmap(m_state, sizeof(SharedState));
+    }
+  }
+
+  bool wait_limit_rate_until(ClockTy::time_point deadline) override {
+    const auto now = nowNs();
+    const auto interval = m_state->interval_ns;
+    const auto tolerance = m_state->tolerance_ns;
+    const auto deadline_ns =
+        deadline == ClockTy::time_point::max()
+            ? std::numeric_limits<int64_t>::max()
+            : std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  deadline.time_since_epoch())
+                  .count();
+
+    // reserve the next slot: TAT' = max(TAT, now) + T
+    int64_t tat = m_state->tat_ns.load(std::memory_order_relaxed);
+    int64_t base = 0;
+    do {
+      base = std::max(tat, now);
+      if (base - tolerance > deadline_ns) {
+        // too late: the slot is not reserved
+        return false;
+      }
+    } while (!m_state->tat_ns.compare_exchange_weak(
+        tat, base + interval, std::memory_order_relaxed));
+
+    // the request conforms if it is not earlier than TAT - tau
+    const auto allowed_at = base - tolerance;
+    if (allowed_at > now) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(allowed_at - now));
+    }
+    return true;
+  }
+
+  /// @brief Remove the shared memory object. Processes that are attached
+  /// keep working, new ones create a new segment.
+  static void remove(const std::string &name) { shm_unlink(name.c_str()); }
+
+private:
+  static constexpr uint64_t ReadyMagic = 0x534f4c5241544531; // "SOLRATE1"
+  // initialization in progress: high bits are the tag, low bits - the pid
+  static constexpr uint64_t InitTag = 0x494e495400000000; // "INIT"
+
+  struct SharedState {
+    std::atomic<uint64_t> state;
+    std::atomic<int64_t> tat_ns;
+    // written once during initialization
+    int64_t interval_ns;
+    int64_t tolerance_ns;
+  };
+  static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                    std::atomic<int64_t>::is_always_lock_free,
+                "process-shared atomics must be lock-free");
+
+  static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  [[noreturn]] void fail(const char *what) const {
+    throw std::runtime_error(std::string(what) + " '" + m_name +
+                             "': " + std::strerror(errno));
+  }
+
+  void attach() {
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_RDWR, 0660);
+    if (fd < 0) {
+      fail("shm_open");
+    }
+    // a new object has zero size; resizing to the same size is harmless and
+    // the new memory is zero-filled (state = 0 - not initialized)
+    struct stat st {};
+    if (fstat(fd, &st) != 0 ||
+        (static_cast<size_t>(st.st_size) < sizeof(SharedState) &&
+         ftruncate(fd, sizeof(SharedState)) != 0)) {
+      close(fd);
+      fail("shm resize");
+    }
+    void *ptr = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+      fail("mmap");
+    }
+    m_state = static_cast<SharedState *>(ptr);
+  }
+
+  void initialize(int64_t interval_ns, int64_t tolerance_ns) {
+    const uint64_t my_tag = InitTag | static_cast<uint32_t>(getpid());
+    while (true) {
+      uint64_t state = m_state->state.load(std::memory_order_acquire);
+      if (state == ReadyMagic) {
+        return;
+      }
+      if (state == 0) {
+        if (m_state->state.compare_exchange_strong(
+                state, my_tag, std::memory_order_acquire)) {
+          m_state->interval_ns = interval_ns;
+          m_state->tolerance_ns = tolerance_ns;
+          m_state->tat_ns.store(nowNs(), std::memory_order_relaxed);
+          m_state->state.store(ReadyMagic, std::memory_order_release);
+          return;
+        }
+        continue;
+      }
+      // somebody is initializing the segment; take over if it has died
+      auto owner = static_cast<pid_t>(state & 0xffffffff);
+      if ((state & ~uint64_t{0xffffffff}) != InitTag ||
+          (kill(owner, 0) != 0 && errno == ESRCH)) {
+        m_state->state.compare_exchange_strong(state, 0,
+                                               std::memory_order_relaxed);
+        continue;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  std::string m_name;
+  SharedState *m_state = nullptr;
+};
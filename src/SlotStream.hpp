@@ -0,0 +1,291 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/// @brief Lock-free bounded single-producer single-consumer ring buffer.
+template <typename T> class SpscChannel final {
+public:
+  SpscChannel(size_t capacity) : m_buffer(roundUpPow2(capacity)) {
+    m_mask = m_buffer.size() - 1;
+  }
+
+  bool try_push(const T &value) {
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == m_buffer.size()) {
+      return false;
+    }
+    m_buffer[tail & m_mask] = value;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T &value) {
+    auto head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = m_buffer[head & m_mask];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  static size_t roundUpPow2(size_t n) {
+    size_t res = 1;
+    while (res < n) {
+      res <<= 1;
+    }
+    return res;
+  }
+
+  std::vector<T> m_buffer;
+  size_t m_mask = 0;
+  // head and tail are written by different threads: avoid false sharing
+  alignas(64) std::atomic<size_t> m_head{0};
+  alignas(64) std::atomic<size_t> m_tail{0};
+};
+
+/// @brief Streaming output stage: delivers results in strict key (slot) order
+/// as soon as they are final.
+///
+/// A result is final when no in-flight request can produce an older key. The
+/// slot observed by the server does not decrease, so a request that is sent
+/// after a response with slot S has been received returns a slot >= S. Each
+/// request gets a ticket with such a lower bound, and the watermark is the
+/// smallest bound of the requests in flight (or the newest received key if
+/// nothing is in flight). Results with a key below the watermark are final.
+///
+/// Final results are passed to the callback (if set) or to a lock-free SPSC
+/// channel which the consumer reads without touching the producers' mutex.
+/// If the channel is full, producers wait for the consumer (backpressure).
+/// Both sides sleep on atomic wait/notify instead of spinning.
+///
+/// The order is strict: a result older than one already delivered (if the
+/// server slot goes back, e.g. behind a load balancer) is late and is dropped
+/// and counted.
+///
+/// NOTE: the callback is called under the stream mutex to keep the order, so
+/// it must be cheap.
+template <typename KeyTy, typename ValTy> class SlotOrderedStream final {
+public:
+  // <key, latency, value> as in ConcurrentContainer
+  using DataTy = std::tuple<KeyTy, size_t, ValTy>;
+  using CallbackTy = std::function<void(const DataTy &)>;
+
+  /// @brief In-flight request. If it is destroyed without complete(), the
+  /// request is considered failed.
+  class Ticket final {
+  public:
+    Ticket(SlotOrderedStream &stream, size_t id)
+        : m_stream(&stream), m_id(id) {}
+    Ticket(Ticket &&other) noexcept
+        : m_stream(std::exchange(other.m_stream, nullptr)), m_id(other.m_id) {}
+    Ticket(const Ticket &) = delete;
+    Ticket &operator=(const Ticket &) = delete;
+    Ticket &operator=(Ticket &&) = delete;
+    ~Ticket() {
+      if (m_stream != nullptr) {
+        m_stream->finish(m_id, nullptr);
+      }
+    }
+
+    void complete(KeyTy key, size_t latency, ValTy value) {
+      if (m_stream != nullptr) {
+        DataTy data(std::move(key), latency, std::move(value));
+        std::exchange(m_stream, nullptr)->finish(m_id, &data);
+      }
+    }
+
+  private:
+    SlotOrderedStream *m_stream = nullptr;
+    size_t m_id = 0;
+  };
+
+  SlotOrderedStream(size_t channel_capacity = 1024)
+      : m_channel(channel_capacity), m_in_flight(64) {}
+
+  /// @brief Deliver results to \p callback instead of the channel. Must be
+  /// set before the first request.
+  void set_callback(CallbackTy callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_callback = std::move(callback);
+  }
+
+  /// @brief Register a request right before it is sent.
+  Ticket begin_request() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_next_ticket - m_first_ticket == m_in_flight.size()) {
+      growInFlight();
+    }
+    auto id = m_next_ticket++;
+    m_in_flight[id & (m_in_flight.size() - 1)] = InFlight{m_newest_key};
+    return Ticket(*this, id);
+  }
+
+  /// @brief No more requests will be made: all pending results are final.
+  void close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    release();
+    m_finished.store(true, std::memory_order_release);
+    signal(m_delivered);
+  }
+
+  /// @brief Consumer side: take the next final result, wait if there is none.
+  /// @return false if the stream is closed and everything is consumed.
+  bool pop(DataTy &res) {
+    while (true) {
+      // read the counter before the check: a delivery after the check
+      // changes it and wakes the wait
+      auto delivered = m_delivered.load(std::memory_order_acquire);
+      if (try_pop(res)) {
+        return true;
+      }
+      if (m_finished.load(std::memory_order_acquire)) {
+        return try_pop(res);
+      }
+      m_delivered.wait(delivered, std::memory_order_acquire);
+    }
+  }
+
+  /// @brief Consumer side: non-blocking version of pop.
+  bool try_pop(DataTy &res) {
+    if (!m_channel.try_pop(res)) {
+      return false;
+    }
+    signal(m_consumed);
+    return true;
+  }
+
+  KeyTy watermark() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return watermarkImpl();
+  }
+
+  /// @return number of dropped late results.
+  size_t late_count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_late_count;
+  }
+
+private:
+  struct KeyGreater final {
+    bool operator()(const DataTy &lhs, const DataTy &rhs) const {
+      return std::get<0>(lhs) > std::get<0>(rhs);
+    }
+  };
+
+  // bound of the key of an in-flight request
+  struct InFlight final {
+    KeyTy bound{};
+    bool finished = false;
+  };
+
+  InFlight &inFlight(size_t ticket) {
+    return m_in_flight[ticket & (m_in_flight.size() - 1)];
+  }
+  const InFlight &inFlight(size_t ticket) const {
+    return m_in_flight[ticket & (m_in_flight.size() - 1)];
+  }
+
+  void growInFlight() {
+    std::vector<InFlight> grown(2 * m_in_flight.size());
+    for (auto id = m_first_ticket; id != m_next_ticket; ++id) {
+      grown[id & (grown.size() - 1)] = inFlight(id);
+    }
+    m_in_flight = std::move(grown);
+  }
+
+  void finish(size_t ticket, DataTy *data) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    inFlight(ticket).finished = true;
+    // the oldest unfinished ticket defines the watermark
+    while (m_first_ticket != m_next_ticket &&
+           inFlight(m_first_ticket).finished) {
+      ++m_first_ticket;
+    }
+    if (data != nullptr) {
+      if (std::get<0>(*data) > m_newest_key) {
+        m_newest_key = std::get<0>(*data);
+      }
+      m_pending.push(std::move(*data));
+    }
+    release();
+  }
+
+  KeyTy watermarkImpl() const {
+    // tickets are issued with non-decreasing bounds: the oldest ticket has
+    // the smallest one
+    return m_first_ticket == m_next_ticket ? m_newest_key
+                                           : inFlight(m_first_ticket).bound;
+  }
+
+  /// Deliver pending results below the watermark (all of them if closed).
+  void release() {
+    const auto watermark = watermarkImpl();
+    while (!m_pending.empty() &&
+           (m_closed || std::get<0>(m_pending.top()) < watermark)) {
+      auto &&data = m_pending.top();
+      if (m_has_delivered && std::get<0>(data) < m_last_key) {
+        ++m_late_count;
+      } else {
+        m_last_key = std::get<0>(data);
+        m_has_delivered = true;
+        deliver(data);
+      }
+      m_pending.pop();
+    }
+  }
+
+  void deliver(const DataTy &data) {
+    if (m_callback) {
+      m_callback(data);
+      return;
+    }
+    while (true) {
+      auto consumed = m_consumed.load(std::memory_order_acquire);
+      if (m_channel.try_push(data)) {
+        break;
+      }
+      // the channel is full: wait for the consumer
+      m_consumed.wait(consumed, std::memory_order_acquire);
+    }
+    signal(m_delivered);
+  }
+
+  static void signal(std::atomic<size_t> &counter) {
+    counter.fetch_add(1, std::memory_order_release);
+    counter.notify_one();
+  }
+
+  SpscChannel<DataTy> m_channel;
+  CallbackTy m_callback;
+
+  // Tickets [m_first_ticket, m_next_ticket) in a ring buffer indexed by the
+  // ticket (power of 2 size). Tickets finish out of order, so a finished one
+  // is marked and leaves when the older ones have. In the steady state
+  // neither this nor m_pending allocates.
+  std::vector<InFlight> m_in_flight;
+  size_t m_first_ticket = 0;
+  size_t m_next_ticket = 0;
+  KeyTy m_newest_key{};
+  std::priority_queue<DataTy, std::vector<DataTy>, KeyGreater> m_pending;
+  bool m_closed = false;
+  // the newest delivered key: older results are late
+  KeyTy m_last_key{};
+  bool m_has_delivered = false;
+  size_t m_late_count = 0;
+  std::atomic<bool> m_finished{false};
+  // change counters to wait on: results put into / taken from the channel
+  std::atomic<size_t> m_delivered{0};
+  std::atomic<size_t> m_consumed{0};
+
+  mutable std::mutex m_mutex;
+};
@@ -4,12 +4,13 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
+
+#include "RpcMethods.hpp"
+#include "Transport.hpp"
 
-#include "cpr/response.h"
 #include "rapidjson/document.h"
-#include "rapidjson/stringbuffer.h"
-#include "rapidjson/writer.h"
-#include <cpr/cpr.h>
 
 // An light wrapper for making requests to the Solana HTTP methods.
 //
@@ -17,48 +18,136 @@
 // Each thread must have its own instance of the class.
 class SolanaRPCClient {
 public:
-  SolanaRPCClient(std::string endpoint) {
-    m_session.SetUrl(cpr::Url{endpoint});
-    m_session.SetHeader(cpr::Header{{"Content-Type", "application/json"}});
-    m_session.SetTimeout(20000);
-
-    // init json template
-    m_requestTmp.SetObject();
-    rapidjson::Document::AllocatorType &allocator = m_requestTmp.GetAllocator();
-    m_requestTmp.AddMember("id", "1", allocator);
-    m_requestTmp.AddMember("jsonrpc", "2.0", allocator);
-    m_requestTmp.AddMember("method", "INVALID_METHOD", allocator);
-    m_requestTmp.AddMember("params", rapidjson::Value(rapidjson::kArrayType),
-                           allocator);
+  /// @param compression see CprTransport.
+  SolanaRPCClient(std::string endpoint, bool compression = false)
+      : m_transport(
+            std::make_unique<CprTransport>(std::move(endpoint), compression)),
+        m_request(std::make_unique<RequestState>()),
+        m_parse_state(std::make_unique<ParseState>()) {}
+
+  /// @brief Client over a custom transport (e.g. recording or replay).
+  SolanaRPCClient(std::unique_ptr<ITransport> transport)
+      : m_transport(std::move(transport)),
+        m_request(std::make_unique<RequestState>()),
+        m_parse_state(std::make_unique<ParseState>()) {}
+
+  /// @brief Time scale of the transport, see ITransport::time_scale.
+  double time_scale() const { return m_transport->time_scale(); }
+
+  // Processing of the result (for example, wait 10 seconds to send a repeat
+  // after 429 or not) is a separate responsibility that may depend on the
+  // usage scenario, so the result keeps the HTTP status and the rate limit
+  // headers. The cpr library stays an implementation detail of the class.
+  template <typename MethodTy, typename... ArgTs>
+  rpc::RpcResult<typename MethodTy::ResultTy> call(ArgTs &&...args) {
+    // trailing parameters (configuration objects) have default values
+    typename MethodTy::ParamsTy params{};
+    assignParams(params, std::index_sequence_for<ArgTs...>{},
+                 std::forward<ArgTs>(args)...);
+
+    auto &&buffer = m_request->buffer;
+    buffer.Clear();
+    MethodTy::writeRequest(buffer, m_request->writer, params);
+    auto &&response = m_transport->post(
+        std::string_view(buffer.GetString(), buffer.GetSize()));
+    return parseResponse<MethodTy>(response);
   }
 
-  // The method returns a raw response from the server, why? Processing the
-  // response from the server is a separate responsibility that may depend on
-  // the usage scenario (for example, wait 10 seconds to send a repeat after 429
-  // or not).
-  // FIXME: replace rpc::Response with a custom type that would hide the
-  // implementation detail of the class - the use of the cpr library.
-  cpr::Response getBalance(const std::string &pubkey) {
-    // prepare json request
-    m_requestTmp["method"].SetString("getBalance");
-    auto &&arr = m_requestTmp["params"].GetArray();
-    arr.Clear();
-    arr.PushBack(rapidjson::StringRef(pubkey.data()),
-                 m_requestTmp.GetAllocator());
-
-    m_session.SetBody(jsonToStr(m_requestTmp));
-    return m_session.Post();
+  auto getBalance(std::string_view pubkey) {
+    return call<rpc::GetBalance>(pubkey);
+  }
+  auto getSlot() { return call<rpc::GetSlot>(); }
+  auto getBlockHeight() { return call<rpc::GetBlockHeight>(); }
+  auto getTransactionCount() { return call<rpc::GetTransactionCount>(); }
+  auto getAccountInfo(std::string_view pubkey) {
+    return call<rpc::GetAccountInfo>(pubkey);
+  }
+  auto getMultipleAccounts(std::span<const std::string> pubkeys) {
+    return call<rpc::GetMultipleAccounts>(pubkeys);
+  }
+  auto getBlock(uint64_t slot) { return call<rpc::GetBlock>(slot); }
+  auto getSignaturesForAddress(std::string_view address, size_t limit = 1000) {
+    rpc::SignaturesConfig config;
+    config.limit = limit;
+    return call<rpc::GetSignaturesForAddress>(address, config);
   }
 
 private:
-  static std::string jsonToStr(const rapidjson::Document &doc) {
-    rapidjson::StringBuffer sb;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
-    doc.Accept(writer);
-    return {sb.GetString(), sb.GetSize()};
+  template <typename ParamsTy, size_t... Is, typename... ArgTs>
+  static void assignParams(ParamsTy &params, std::index_sequence<Is...>,
+                           ArgTs &&...args) {
+    ((std::get<Is>(params) = std::forward<ArgTs>(args)), ...);
+  }
+
+  template <typename MethodTy>
+  rpc::RpcResult<typename MethodTy::ResultTy>
+  parseResponse(HttpResponse &response) {
+    rpc::RpcResult<typename MethodTy::ResultTy> result;
+    result.status_code = response.status_code;
+    result.feedback = response.feedback;
+    result.wire_bytes = response.wire_bytes;
+    if (response.status_code == 0) {
+      result.error = response.error;
+      return result;
+    }
+    if (!cpr::status::is_success(response.status_code)) {
+      // copy: the buffer is reused by the transport
+      result.error = response.text;
+      return result;
+    }
+
+    // the memory of the previous document is reused
+    m_parse_state->value_allocator.Clear();
+    m_parse_state->stack_allocator.Clear();
+    DocumentTy document(&m_parse_state->value_allocator,
+                        ParseState::StackCapacity,
+                        &m_parse_state->stack_allocator);
+    if (document.ParseInsitu(response.text.data()).HasParseError())
+      throw std::runtime_error("Parsing error");
+    if (auto *error = rpc::member(document, "error")) {
+      rpc::parseMember(*error, "code", result.rpc_error_code);
+      rpc::parseMember(*error, "message", result.error);
+      return result;
+    }
+    auto *value = rpc::member(document, "result");
+    typename MethodTy::ResultTy parsed{};
+    if (value == nullptr || !MethodTy::parseResult(*value, parsed)) {
+      result.error = "Incomplete response";
+      return result;
+    }
+    result.value = std::move(parsed);
+    return result;
   }
 
 private:
-  cpr::Session m_session;
-  rapidjson::Document m_requestTmp;
+  /// Request buffer and its writer. Both keep their memory between requests
+  /// (the writer - its stack of the nested parameters).
+  struct RequestState final {
+    rpc::RequestBufferTy buffer;
+    rpc::WriterTy writer{buffer};
+  };
+
+  /// Memory of the parsed document. A response that fits the buffers is
+  /// parsed without heap allocations (a getBalance response needs ~1 KiB),
+  /// a larger one takes chunks from the heap until the next response.
+  struct ParseState final {
+    static constexpr size_t ValueBufferSize = 64 * 1024;
+    static constexpr size_t StackBufferSize = 8 * 1024;
+    // less than the buffer: the pool keeps a chunk header in it
+    static constexpr size_t StackCapacity = 4 * 1024;
+
+    char value_buffer[ValueBufferSize];
+    char stack_buffer[StackBufferSize];
+    rpc::JsonPoolTy value_allocator{value_buffer, ValueBufferSize};
+    // the pool doesn't free memory, so the parser keeps its stack
+    rpc::JsonPoolTy stack_allocator{stack_buffer, StackBufferSize};
+  };
+  using DocumentTy = rapidjson::GenericDocument<
+      rapidjson::UTF8<>, rpc::JsonPoolTy, rpc::JsonPoolTy>;
+
+  std::unique_ptr<ITransport> m_transport;
+  // heap-allocated once: the client stays movable (the writer points to
+  // the buffer)
+  std::unique_ptr<RequestState> m_request;
+  std::unique_ptr<ParseState> m_parse_state;
 };
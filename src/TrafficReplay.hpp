@@ -0,0 +1,295 @@
+#pragma once
+
+#include "Transport.hpp"
+#include "Varint.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/// Record and replay of RPC traffic.
+///
+/// RecordingTransport wraps a real transport and logs every exchange (request,
+/// response body, status, headers and timing) to a compact binary file.
+/// ReplayTransport serves the logged responses back in the recorded order,
+/// with the recorded latencies, at 1x-100x speed. So the handler, the rate
+/// controllers, the error handler and the container can be benchmarked
+/// offline under production traffic: 429 bursts, slot skew between workers,
+/// slow tails.
+///
+/// File format: "SOLTRAF1", then records; a record is its size (varint) and
+/// the fields:
+///   sent_us, elapsed_us, status_code, wire_bytes      varints
+///   request, response body, error message             varint size + bytes
+///   header count, then names and values               varint size + bytes
+/// sent_us is the time of the request since the start of the recording.
+namespace traffic {
+
+constexpr std::string_view FileMagic = "SOLTRAF1";
+
+struct Record final {
+  uint64_t sent_us = 0;
+  uint64_t elapsed_us = 0;
+  long status_code = 0;
+  uint64_t wire_bytes = 0;
+  std::string request;
+  std::string text;
+  std::string error;
+  cpr::Header header;
+  // extracted from the headers once, on load
+  RateFeedback feedback;
+};
+
+/// @brief Thread-safe writer of the traffic log.
+class Recorder final {
+public:
+  using ClockTy = std::chrono::steady_clock;
+
+  Recorder(const std::filesystem::path &path)
+      : m_out(path, std::ios::binary | std::ios::trunc),
+        m_start(ClockTy::now()) {
+    if (!m_out) {
+      throw std::runtime_error("can't open " + path.string());
+    }
+    m_out.write(FileMagic.data(), FileMagic.size());
+  }
+
+  void record(ClockTy::time_point sent, std::string_view request,
+              const HttpResponse &response) {
+    std::string buf;
+    putVarint(buf, std::chrono::duration_cast<std::chrono::microseconds>(
+                       sent - m_start)
+                       .count());
+    putVarint(buf, static_cast<uint64_t>(response.elapsed * 1000000));
+    putVarint(buf, static_cast<uint64_t>(response.status_code));
+    putVarint(buf, response.wire_bytes);
+    putString(buf, request);
+    putString(buf, response.text);
+    putString(buf, response.error);
+    putVarint(buf, response.header.size());
+    for (auto &&[name, value] : response.header) {
+      putString(buf, name);
+      putString(buf, value);
+    }
+
+    std::string size;
+    putVarint(size, buf.size());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_out.write(size.data(), size.size());
+    m_out.write(buf.data(), buf.size());
+    ++m_count;
+  }
+
+  size_t count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+  }
+
+private:
+  static void putVarint(std::string &buf, uint64_t value) {
+    uint8_t bytes[MaxVarintSize];
+    buf.append(reinterpret_cast<const char *>(bytes),
+               encodeVarint(value, bytes));
+  }
+
+  static void putString(std::string &buf, std::string_view str) {
+    putVarint(buf, str.size());
+    buf.append(str);
+  }
+
+  std::ofstream m_out;
+  ClockTy::time_point m_start;
+  size_t m_count = 0;
+  mutable std::mutex m_mutex;
+};
+
+/// @brief Transport that passes requests to another one and logs them.
+///
+/// NOTE: the recorder is shared by the transports of all threads and must
+/// outlive them.
+class RecordingTransport final : public ITransport {
+public:
+  RecordingTransport(std::unique_ptr<ITransport> transport, Recorder &recorder)
+      : m_transport(std::move(transport)), m_recorder(recorder) {}
+
+  HttpResponse &post(std::string_view body) override {
+    auto sent = Recorder::ClockTy::now();
+    auto &&response = m_transport->post(body);
+    m_recorder.record(sent, body, response);
+    return response;
+  }
+
+  double time_scale() const override { return m_transport->time_scale(); }
+
+private:
+  std::unique_ptr<ITransport> m_transport;
+  Recorder &m_recorder;
+};
+
+/// @brief Traffic log loaded for replay, shared by all replay transports.
+///
+/// The transports take records with one shared cursor, so the responses are
+/// served in the recorded order whatever thread asks. Time of the replay is
+/// the recorded time divided by the speed.
+class Log final {
+public:
+  using ClockTy = std::chrono::steady_clock;
+
+  /// @param speed replay speed, e.g. 10 - ten times faster than recorded.
+  /// @param loop start over when the records are over.
+  Log(const std::filesystem::path &path, double speed = 1.0, bool loop = true)
+      : m_speed(speed), m_loop(loop) {
+    if (speed <= 0) {
+      throw std::invalid_argument("speed must be positive");
+    }
+    load(path);
+    if (m_records.empty()) {
+      throw std::runtime_error("no records in " + path.string());
+    }
+    for (auto &&rec : m_records) {
+      m_duration_us = std::max(m_duration_us, rec.sent_us + rec.elapsed_us);
+    }
+  }
+
+  Log(const Log &) = delete;
+  Log &operator=(const Log &) = delete;
+
+  /// @brief Take the next record.
+  /// @param deliver_at time when the response is to be delivered.
+  /// @return nullptr if the log is over.
+  const Record *next(ClockTy::time_point &deliver_at) {
+    auto idx = m_cursor.fetch_add(1, std::memory_order_relaxed);
+    if (!m_loop && idx >= m_records.size()) {
+      return nullptr;
+    }
+    auto lap = idx / m_records.size();
+    auto &&rec = m_records[idx % m_records.size()];
+
+    // The replay starts with the first request. A response comes after its
+    // latency, but not earlier than on the recorded timeline: the replay
+    // keeps the recorded pace and bursts even if the client is faster.
+    auto now = ClockTy::now();
+    std::call_once(m_started, [this, now]() { m_start = now; });
+    auto arrival_us = lap * m_duration_us + rec.sent_us + rec.elapsed_us;
+    deliver_at = std::max(now + scaled(rec.elapsed_us),
+                          m_start + scaled(arrival_us));
+    return &rec;
+  }
+
+  double speed() const { return m_speed; }
+  size_t size() const { return m_records.size(); }
+
+  std::chrono::nanoseconds scaled(uint64_t us) const {
+    return std::chrono::nanoseconds(static_cast<int64_t>(us * 1000 / m_speed));
+  }
+
+private:
+  void load(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    if (data.compare(0, FileMagic.size(), FileMagic) != 0) {
+      throw std::runtime_error("not a traffic log: " + path.string());
+    }
+    auto *pos = reinterpret_cast<const uint8_t *>(data.data());
+    auto *end = pos + data.size();
+    pos += FileMagic.size();
+    while (pos != end) {
+      auto size = readVarint(pos, end);
+      if (size > static_cast<uint64_t>(end - pos)) {
+        // the recording was interrupted in the middle of a record
+        break;
+      }
+      m_records.push_back(parse(pos, pos + size));
+      pos += size;
+    }
+  }
+
+  static Record parse(const uint8_t *pos, const uint8_t *end) {
+    auto str = [&]() {
+      auto size = std::min<uint64_t>(readVarint(pos, end), end - pos);
+      std::string res(reinterpret_cast<const char *>(pos), size);
+      pos += size;
+      return res;
+    };
+    Record rec;
+    rec.sent_us = readVarint(pos, end);
+    rec.elapsed_us = readVarint(pos, end);
+    rec.status_code = static_cast<long>(readVarint(pos, end));
+    rec.wire_bytes = readVarint(pos, end);
+    rec.request = str();
+    rec.text = str();
+    rec.error = str();
+    for (auto count = readVarint(pos, end); count > 0; --count) {
+      auto name = str();
+      rec.header[name] = str();
+    }
+    rec.feedback = makeRateFeedback(
+        rec.status_code, static_cast<double>(rec.elapsed_us) / 1000000,
+        rec.header);
+    return rec;
+  }
+
+  std::vector<Record> m_records;
+  double m_speed = 1.0;
+  bool m_loop = true;
+  uint64_t m_duration_us = 0;
+
+  std::atomic<size_t> m_cursor{0};
+  std::once_flag m_started;
+  ClockTy::time_point m_start;
+};
+
+/// @brief Transport that serves responses from a traffic log.
+///
+/// The request is not sent anywhere and doesn't select the response: the
+/// log is replayed in order. The response elapsed time is the real
+/// (scaled) time, so it agrees with what the caller measures. The headers
+/// are not copied, only the rate limit feedback: in the steady state the
+/// replay doesn't allocate.
+class ReplayTransport final : public ITransport {
+public:
+  ReplayTransport(Log &log) : m_log(log) {}
+
+  HttpResponse &post(std::string_view) override {
+    auto start = Log::ClockTy::now();
+    auto deliver_at = start;
+    auto *rec = m_log.next(deliver_at);
+    if (rec == nullptr) {
+      m_response = HttpResponse{};
+      m_response.error = "replay log is over";
+      return m_response;
+    }
+    std::this_thread::sleep_until(deliver_at);
+
+    // assignment reuses the buffers of the previous response
+    m_response.status_code = rec->status_code;
+    m_response.text = rec->text;
+    m_response.error = rec->error;
+    m_response.wire_bytes = rec->wire_bytes;
+    std::chrono::duration<double> elapsed = Log::ClockTy::now() - start;
+    m_response.elapsed = elapsed.count();
+    m_response.feedback = rec->feedback;
+    m_response.feedback.latency_ms =
+        static_cast<int64_t>(m_response.elapsed * 1000);
+    return m_response;
+  }
+
+  double time_scale() const override { return 1.0 / m_log.speed(); }
+
+private:
+  Log &m_log;
+  HttpResponse m_response;
+};
+
+} // namespace traffic
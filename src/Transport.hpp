@@ -0,0 +1,221 @@
+#pragma once
+
+#include "IRateController.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "cpr/response.h"
+#include <cpr/cpr.h>
+#include <curl/curl.h>
+
+/// @return numeric value of \p str or nullopt if it is invalid.
+inline std::optional<size_t> toNumber(std::string_view str) {
+  size_t value = 0;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if (ec != std::errc{}) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+/// @return \p lhs and \p rhs are equal ignoring the case of ASCII letters
+/// (header names are case-insensitive).
+inline bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs) {
+  auto &&lower = [](char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+  };
+  return lhs.size() == rhs.size() &&
+         std::equal(lhs.begin(), lhs.end(), rhs.begin(),
+                    [&](char l, char r) { return lower(l) == lower(r); });
+}
+
+/// @brief Add the header \p name: \p value to the rate limit information, if
+/// it is about rate limits.
+inline void applyRateHeader(RateFeedback &feedback, std::string_view name,
+                            std::string_view value) {
+  auto &&number = toNumber(value);
+  if (!number) {
+    return;
+  }
+  if (equalsIgnoreCase(name, "retry-after")) {
+    // only the delay-seconds form of retry-after is supported
+    feedback.retry_after_ms = *number * 1000;
+  } else if (equalsIgnoreCase(name, "x-ratelimit-rps-limit")) {
+    feedback.rps_limit = number;
+  } else if (equalsIgnoreCase(name, "x-ratelimit-rps-remaining") ||
+             equalsIgnoreCase(name, "x-ratelimit-method-remaining")) {
+    feedback.remaining =
+        std::min(*number, feedback.remaining.value_or(*number));
+  }
+}
+
+/// @brief Extract the information about rate limits from the response.
+/// @param elapsed request time in seconds.
+inline RateFeedback makeRateFeedback(long status_code, double elapsed,
+                                     const cpr::Header &header) {
+  RateFeedback feedback;
+  feedback.status_code = status_code;
+  feedback.latency_ms = static_cast<int64_t>(elapsed * 1000);
+  for (auto &&[name, value] : header) {
+    applyRateHeader(feedback, name, value);
+  }
+  return feedback;
+}
+
+/// @brief HTTP response as seen by SolanaRPCClient.
+///
+/// The object belongs to the transport and is reused by the next request, so
+/// in the steady state its buffers don't reallocate.
+struct HttpResponse final {
+  // HTTP status, 0 - the request was not delivered (e.g. timeout)
+  long status_code = 0;
+  std::string text;
+  // transport error message
+  std::string error;
+  // request time in seconds
+  double elapsed = 0;
+  // size of the body on the wire (compressed, if it was)
+  size_t wire_bytes = 0;
+  // rate limit information from the headers
+  RateFeedback feedback;
+  // all headers, if the transport keeps them
+  cpr::Header header;
+};
+
+/// @brief Delivery of JSON-RPC requests to the node.
+///
+/// SolanaRPCClient builds requests and parses responses, the transport only
+/// moves bytes. It is an extension point for recording and replaying traffic.
+///
+/// NOTE: like the client, a transport is used by one thread.
+class ITransport {
+public:
+  /// @brief Send \p body with POST and wait for the response.
+  /// @return the response, valid until the next call.
+  virtual HttpResponse &post(std::string_view body) = 0;
+  /// @brief Pace of the transport time relative to the real one, e.g. 0.1
+  /// for a replay 10 times faster. Waits between retries are scaled by it.
+  virtual double time_scale() const { return 1.0; }
+  virtual ~ITransport() {}
+};
+
+/// @brief HTTP transport over a cpr session (the default one).
+class CprTransport final : public ITransport {
+public:
+  /// @param compression advertise compressed encodings of the response.
+  /// Large responses (blocks, account lists) are 3-10 times smaller on the
+  /// wire, small ones gain nothing and cost some CPU.
+  /// @param keep_headers fill HttpResponse::header (e.g. for recording),
+  /// which costs a map of strings per response.
+  CprTransport(std::string endpoint, bool compression = false,
+               bool keep_headers = false)
+      : m_keep_headers(keep_headers) {
+    m_session.SetUrl(cpr::Url{endpoint});
+    m_session.SetHeader(cpr::Header{{"Content-Type", "application/json"}});
+    m_session.SetTimeout(20000);
+    if (compression) {
+      // libcurl decodes the body chunk by chunk as it arrives, so the plain
+      // JSON is never buffered compressed: the response text, which is then
+      // parsed in place, is the only buffer.
+      if (auto &&encodings = supportedEncodings()) {
+        m_session.SetAcceptEncoding(*encodings);
+      }
+    }
+    // OPTIMIZATION: the body is appended to the recycled buffer instead of a
+    // new string of each cpr::Response
+    m_session.SetWriteCallback(
+        cpr::WriteCallback{[this](std::string_view data, intptr_t) {
+          m_response.text.append(data);
+          return true;
+        }});
+    // OPTIMIZATION: the rate limit headers are parsed as they arrive, so cpr
+    // doesn't build a header map of each response
+    m_session.SetHeaderCallback(
+        cpr::HeaderCallback{[this](std::string_view line, intptr_t) {
+          onHeader(line);
+          return true;
+        }});
+  }
+
+  CprTransport(const CprTransport &) = delete;
+  CprTransport &operator=(const CprTransport &) = delete;
+
+  HttpResponse &post(std::string_view body) override {
+    m_session.SetBody(cpr::Body{body.data(), body.size()});
+    m_response.text.clear();
+    resetHeaders();
+    auto &&r = m_session.Post();
+    m_response.status_code = r.status_code;
+    m_response.error = r.error.message;
+    m_response.elapsed = r.elapsed;
+    m_response.wire_bytes = static_cast<size_t>(r.downloaded_bytes);
+    m_response.feedback.status_code = r.status_code;
+    m_response.feedback.latency_ms = static_cast<int64_t>(r.elapsed * 1000);
+    return m_response;
+  }
+
+private:
+  /// @param line a header line as libcurl passes it, with CRLF.
+  void onHeader(std::string_view line) {
+    // a status line starts the headers of the next response (e.g. after
+    // 100 Continue or a redirect), only the last one counts
+    if (line.starts_with("HTTP/")) {
+      resetHeaders();
+      return;
+    }
+    auto colon = line.find(':');
+    if (colon == std::string_view::npos) {
+      return;
+    }
+    auto &&trim = [](std::string_view str) {
+      auto begin = str.find_first_not_of(" \t\r\n");
+      if (begin == std::string_view::npos) {
+        return std::string_view{};
+      }
+      auto end = str.find_last_not_of(" \t\r\n");
+      return str.substr(begin, end - begin + 1);
+    };
+    auto name = trim(line.substr(0, colon));
+    auto value = trim(line.substr(colon + 1));
+    applyRateHeader(m_response.feedback, name, value);
+    if (m_keep_headers) {
+      m_response.header[std::string(name)] = std::string(value);
+    }
+  }
+
+  void resetHeaders() {
+    m_response.feedback = RateFeedback{};
+    if (m_keep_headers) {
+      m_response.header.clear();
+    }
+  }
+
+  /// Encodings that the linked libcurl can decode, the preferred first.
+  /// nullopt if it can't decode any: an advertised encoding that libcurl
+  /// can't decode would reach the parser compressed.
+  static std::optional<cpr::AcceptEncoding> supportedEncodings() {
+    auto *info = curl_version_info(CURLVERSION_NOW);
+    const bool zstd = (info->features & CURL_VERSION_ZSTD) != 0;
+    // gzip and deflate are decoded by zlib
+    const bool zlib = (info->features & CURL_VERSION_LIBZ) != 0;
+    if (zstd && zlib) {
+      return cpr::AcceptEncoding{"zstd", "gzip", "deflate"};
+    }
+    if (zstd) {
+      return cpr::AcceptEncoding{"zstd"};
+    }
+    if (zlib) {
+      return cpr::AcceptEncoding{"gzip", "deflate"};
+    }
+    return std::nullopt;
+  }
+
+  cpr::Session m_session;
+  HttpResponse m_response;
+  bool m_keep_headers = false;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr size_t MaxVarintSize = 10;
+
+/// @brief Encode \p value as LEB128 varint into \p out.
+/// @return number of written bytes.
+inline size_t encodeVarint(uint64_t value, uint8_t *out) {
+  size_t size = 0;
+  while (value >= 0x80) {
+    out[size++] = static_cast<uint8_t>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out[size++] = static_cast<uint8_t>(value);
+  return size;
+}
+
+/// @brief Read a varint at \p pos and advance it.
+inline uint64_t readVarint(const uint8_t *&pos, const uint8_t *end) {
+  uint64_t value = 0;
+  for (unsigned shift = 0; pos != end && shift < 64; shift += 7) {
+    auto byte = *pos++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      break;
+    }
+  }
+  return value;
+}
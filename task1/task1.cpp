@@ -6,7 +6,12 @@ int main() {
     SolanaRPCClient cl("https://api.testnet.solana.com/");
     auto &&res = cl.getBalance("CsobwrE9x7qfKC23GFWPq8FMVWzVCErWh1A7C2dMBNMM");
     std::cout << "Status: " << res.status_code << std::endl;
-    std::cout << "Response: " << res.text << std::endl;
+    if (res.ok()) {
+        std::cout << "Slot: " << res.value->slot << std::endl;
+        std::cout << "Balance: " << res.value->value << std::endl;
+    } else {
+        std::cout << "Error: " << res.error << std::endl;
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include "Container.hpp"
+#include "DefaultEventHandler.hpp"
+#include "LimitRateController.hpp"
+#include "MultiAccountEventHandler.hpp"
+#include "ShardedSeriesStore.hpp"
+#include "SlotStream.hpp"
+#include "TrafficReplay.hpp"
+
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Offline benchmark of the task 2 processing under recorded traffic.
+//
+// Record the traffic of the real node:
+//   ./replay_bench --record traffic.bin [num_events=1000]
+// Replay it (10 times faster by default):
+//   ./replay_bench traffic.bin [speed=10] [num_events=1000]
+// Check that an INVOKE doesn't allocate in the steady state (offline, with
+// synthetic traffic; the exit code is 1 if it does):
+//   ./replay_bench --check-allocations [num_events=1000]
+// Track many accounts with getMultipleAccounts (offline, synthetic):
+//   ./replay_bench --accounts [num_accounts=1000] [num_events=1000]
+
+constexpr auto ENDPOINT = "https://api.devnet.solana.com/";
+constexpr auto PUBKEY = "CsobwrE9x7qfKC23GFWPq8FMVWzVCErWh1A7C2dMBNMM";
+
+// Heap allocations of the whole program, for the steady state check.
+std::atomic<size_t> allocation_count{0};
+
+void *operator new(size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+template <typename TransportFactoryTy>
+void run(TransportFactoryTy &&make_transport, IRateController &controller,
+         size_t num_events) {
+  ConcurrentContainer<size_t, size_t> results(10);
+  std::atomic<size_t> next_event{0};
+
+  const auto start = std::chrono::steady_clock::now();
+  tbb::task_group tg;
+  const int num_workers = tbb::this_task_arena::max_concurrency();
+  for (int i = 0; i < num_workers; ++i) {
+    tg.run([&]() {
+      DefaultEventHandler handler(SolanaRPCClient(make_transport()), PUBKEY,
+                                  results, controller);
+      Event event;
+      event.type = EventTy::INVOKE;
+      while (next_event.fetch_add(1) < num_events) {
+        handler.handleEvent(event);
+      }
+    });
+  }
+  tg.wait();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << "Events: " << num_events << " in " << elapsed.count() << " s ("
+            << num_events / elapsed.count() << " events/s)" << std::endl;
+  std::cout << "Results count: " << results.size() << std::endl;
+  if (results.size() != 0) {
+    std::cout << "Oldest slot: " << std::get<0>(results.top_older())
+              << std::endl;
+    std::cout << "Newest slot: " << std::get<0>(results.top_newer())
+              << std::endl;
+    std::cout << "Standard deviation: " << results.standard_deviation()
+              << " ms" << std::endl;
+  }
+}
+
+// Synthetic traffic: \p count successful responses 1 ms apart, the body of
+// the i-th one is make_result(i) (the "value" of a response with context).
+template <typename ResultFactoryTy>
+std::filesystem::path makeSyntheticLog(const std::string &name, size_t count,
+                                       ResultFactoryTy &&make_result) {
+  auto path = std::filesystem::temp_directory_path() / name;
+  traffic::Recorder recorder(path);
+  const auto start = traffic::Recorder::ClockTy::now();
+  HttpResponse response;
+  response.status_code = 200;
+  response.elapsed = 0.001;
+  for (size_t i = 0; i < count; ++i) {
+    // slots grow with the time
+    response.text = R"({"jsonrpc":"2.0","result":{"context":{"slot":)" +
+                    std::to_string(300000000 + i) +
+                    R"(},"value":)" + make_result(i) + R"(},"id":1})";
+    response.wire_bytes = response.text.size();
+    recorder.record(start + std::chrono::milliseconds(i), "", response);
+  }
+  return path;
+}
+
+// In the steady state an INVOKE must not touch the heap: the client reuses
+// its request, response and parsing buffers, the container reuses evicted
+// nodes, the stream reuses its ticket ring and pending heap. Error responses
+// are the exception (the message is copied), so the traffic is synthetic.
+// @return false if an INVOKE allocated after the warm-up.
+bool checkAllocations(size_t num_events) {
+  traffic::Log log(makeSyntheticLog("replay_bench_balance.bin", 100,
+                                   [](size_t i) {
+                                     return std::to_string(1000000000 +
+                                                           i * 5000);
+                                   }),
+                  /*speed=*/100);
+  ConcurrentContainer<size_t, size_t> results(
+      10, RetentionPolicy{.max_entries = 100});
+  SlotOrderedStream<size_t, size_t> stream(1024);
+  // the limit doesn't matter here, only its bookkeeping
+  LimitRateController controller(1000, 1000000);
+  DefaultEventHandler handler(
+      SolanaRPCClient(std::make_unique<traffic::ReplayTransport>(log)), PUBKEY,
+      results, controller, &stream);
+  Event event;
+  event.type = EventTy::INVOKE;
+  SlotOrderedStream<size_t, size_t>::DataTy streamed;
+
+  // fill the buffers and the pools, the log loops over all records
+  const size_t warm_up = 2 * log.size();
+  for (size_t i = 0; i < warm_up; ++i) {
+    handler.handleEvent(event);
+    while (stream.try_pop(streamed)) {
+    }
+  }
+  // rapidjson takes its memory with std::malloc, it is counted separately
+  auto &&count = []() {
+    return allocation_count.load() + rpc::CountingAllocator::allocations();
+  };
+  auto before = count();
+  for (size_t i = 0; i < num_events; ++i) {
+    handler.handleEvent(event);
+    while (stream.try_pop(streamed)) {
+    }
+  }
+  auto allocations = count() - before;
+  std::cout << "Allocations per INVOKE after warm-up: "
+            << static_cast<double>(allocations) / num_events << " ("
+            << allocations << " in " << num_events << " events)" << std::endl;
+  return allocations == 0;
+}
+
+// Many accounts: each INVOKE requests all of them with getMultipleAccounts
+// and puts the balances into the sharded store.
+void runAccounts(size_t num_accounts, size_t num_events) {
+  traffic::Log log(
+      makeSyntheticLog(
+          "replay_bench_accounts.bin", 100,
+          [](size_t i) {
+            std::string res = "[";
+            for (size_t j = 0; j < MultiAccountEventHandler::MaxBatchSize;
+                 ++j) {
+              res += (j == 0 ? "" : ",");
+              res += R"({"data":["","base64"],"executable":false,)"
+                     R"("lamports":)" +
+                     std::to_string(1000000 + i * 100 + j) +
+                     R"(,"owner":"11111111111111111111111111111111",)"
+                     R"("rentEpoch":0})";
+            }
+            return res + "]";
+          }),
+      /*speed=*/10);
+  std::vector<std::string> pubkeys;
+  for (size_t i = 0; i < num_accounts; ++i) {
+    pubkeys.push_back("account" + std::to_string(i));
+  }
+  ShardedSeriesStore<size_t, size_t> store;
+  // the limit doesn't matter here, only its bookkeeping
+  LimitRateController controller(1000, 1000000);
+  std::atomic<size_t> next_event{0};
+
+  const auto start = std::chrono::steady_clock::now();
+  tbb::task_group tg;
+  const int num_workers = tbb::this_task_arena::max_concurrency();
+  for (int i = 0; i < num_workers; ++i) {
+    tg.run([&]() {
+      MultiAccountEventHandler handler(
+          SolanaRPCClient(std::make_unique<traffic::ReplayTransport>(log)),
+          pubkeys, store, controller);
+      Event event;
+      event.type = EventTy::INVOKE;
+      while (next_event.fetch_add(1) < num_events) {
+        handler.handleEvent(event);
+      }
+    });
+  }
+  tg.wait();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  auto aggregate = store.aggregate();
+  std::cout << "Events: " << num_events << " in " << elapsed.count() << " s ("
+            << num_events / elapsed.count() << " events/s)" << std::endl;
+  std::cout << "Accounts: " << store.series_count() << " in "
+            << store.shard_count() << " shards" << std::endl;
+  std::cout << "Samples in the windows: " << aggregate.count << std::endl;
+  std::cout << "Mean latency: " << aggregate.mean_latency()
+            << " ms, standard deviation: " << aggregate.standard_deviation()
+            << " ms" << std::endl;
+  std::cout << "Balance delta: " << aggregate.balance_delta << std::endl;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " --record <file> [num_events]\n"
+              << "       " << argv[0] << " <file> [speed] [num_events]\n"
+              << "       " << argv[0] << " --check-allocations [num_events]\n"
+              << "       " << argv[0]
+              << " --accounts [num_accounts] [num_events]" << std::endl;
+    return 1;
+  }
+
+  if (std::string(argv[1]) == "--check-allocations") {
+    size_t num_events = argc > 2 ? std::stoul(argv[2]) : 1000;
+    if (!checkAllocations(num_events)) {
+      std::cerr << "ERROR: INVOKE allocates in the steady state" << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (std::string(argv[1]) == "--accounts") {
+    size_t num_accounts = argc > 2 ? std::stoul(argv[2]) : 1000;
+    size_t num_events = argc > 3 ? std::stoul(argv[3]) : 1000;
+    runAccounts(num_accounts, num_events);
+    return 0;
+  }
+
+  if (std::string(argv[1]) == "--record") {
+    if (argc < 3) {
+      std::cerr << "No file to record" << std::endl;
+      return 1;
+    }
+    size_t num_events = argc > 3 ? std::stoul(argv[3]) : 1000;
+    traffic::Recorder recorder(argv[2]);
+    // NOTE: 50 requests per 10 s for testnet
+    LimitRateController controller(10000, 200);
+    run(
+        [&recorder]() {
+          return std::make_unique<traffic::RecordingTransport>(
+              std::make_unique<CprTransport>(ENDPOINT, /*compression=*/false,
+                                             /*keep_headers=*/true),
+              recorder);
+        },
+        controller, num_events);
+    std::cout << "Recorded: " << recorder.count() << " responses" << std::endl;
+    return 0;
+  }
+
+  double speed = argc > 2 ? std::stod(argv[2]) : 10;
+  size_t num_events = argc > 3 ? std::stoul(argv[3]) : 1000;
+  traffic::Log log(argv[1], speed);
+  std::cout << "Replay " << log.size() << " responses at " << speed << "x"
+            << std::endl;
+  // the limit window is scaled with the time
+  LimitRateController controller(static_cast<size_t>(10000 / speed), 200);
+  run([&log]() { return std::make_unique<traffic::ReplayTransport>(log); },
+      controller, num_events);
+  return 0;
+}
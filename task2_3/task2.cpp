@@ -1,41 +1,111 @@
+#include "AdaptiveRateController.hpp"
 #include "Container.hpp"
 #include "DefaultEventHandler.hpp"
+#include "EventQueue.hpp"
+#include "SharedMemoryRateController.hpp"
+#include "SlotStream.hpp"
 
-#include <tbb/task_group.h>
+#include <tbb/task_arena.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <thread>
 #include <vector>
 
 // FIXME: container and rateController shouldn't be global.
 //        (thread_local doesn't work inside functions).
 // <slot, latency>
 // Count standard deviation in last 10 slots
-ConcurrentContainer<size_t, size_t> results(10);
-// NOTE: 50 requests for testnet
-LimitRateController limit_controller(10000, 200);
+// Keep at most 100000 results (~5MB) and only the last ~12 hours of slots.
+ConcurrentContainer<size_t, size_t>
+    results(10, RetentionPolicy{.max_entries = 100000, .max_key_age = 100000});
+// Several processes with one RPC key share the limit through shared memory:
+//   SOLANA_SHM_LIMITER=/solana_rpc_limit ./task2
+// Otherwise the adaptive limit starts at the documented 200 requests per 10 s
+// and follows the real capacity of the provider (NOTE: 50 requests for
+// testnet).
+std::unique_ptr<IRateController> makeRateController() {
+  if (const char *shm_name = std::getenv("SOLANA_SHM_LIMITER")) {
+    return std::make_unique<SharedMemoryRateController>(shm_name, 10000, 200);
+  }
+  return std::make_unique<AdaptiveRateController>(
+      AdaptiveRateConfig{.initial_in_flight = 4,
+                         .max_in_flight = 64,
+                         .initial_rate = 20,
+                         .max_rate = 100});
+}
+std::unique_ptr<IRateController> limit_controller = makeRateController();
+// Results in slot order while the events are still processed.
+SlotOrderedStream<size_t, size_t> results_stream(1024);
 // OPTIMIZATION: create client for each thread only once
 thread_local DefaultEventHandler
     event_handler("https://api.devnet.solana.com/",
                   "CsobwrE9x7qfKC23GFWPq8FMVWzVCErWh1A7C2dMBNMM", results,
-                  limit_controller);
+                  *limit_controller, &results_stream);
 
 int main() {
   // generate syntactic events stream
+  // Every 10th event is latency-critical, every 4th is bulk.
   size_t num_tasks = 1000;
-  std::vector<EventTy> m_events(num_tasks);
+  std::vector<Event> m_events(num_tasks);
   for (size_t i = 0; i < num_tasks; ++i) {
-    m_events[i] = static_cast<EventTy>(i % 3);
+    m_events[i].type = static_cast<EventTy>(i % 3);
+    m_events[i].priority = i % 10 == 0  ? EventPriority::CRITICAL
+                           : i % 4 == 0 ? EventPriority::BULK
+                                        : EventPriority::NORMAL;
   }
 
+  // Downstream processing runs alongside the collection: the consumer gets
+  // final results in strict slot order.
+  size_t streamed_count = 0;
+  size_t last_streamed_slot = 0;
+  std::thread consumer([&]() {
+    SlotOrderedStream<size_t, size_t>::DataTy result;
+    while (results_stream.pop(result)) {
+      ++streamed_count;
+      last_streamed_slot = std::get<0>(result);
+    }
+  });
+
   // precess events in parallel.
-  // TBB organizes a queue of tasks with a pool of threads, the number of which
-  // can be adjusted.
-  tbb::task_group tg;
+  // The producer puts events into a bounded queue, a fixed number of worker
+  // threads take them out. So the backlog can't grow without limit if the
+  // producer outpaces the network and the rate limit.
+  // Classes share the workers (and so the rate limit tokens) 8:4:1.
+  BoundedEventQueue queue(256, OverflowPolicy::DROP_NOTHING_FIRST,
+                          /*coalesce_invokes=*/false,
+                          SchedulingPolicy::WEIGHTED_FAIR, {8, 4, 1});
+  // The workers block on the queue, so they are dedicated threads: a TBB
+  // task would need a free arena thread, and with one CPU the producer
+  // (blocked on a full queue) would be the only one.
+  const int num_workers =
+      std::max(tbb::this_task_arena::max_concurrency(), 2);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < num_workers; ++i) {
+    workers.emplace_back([&queue]() {
+      Event cur_event;
+      while (queue.pop(cur_event)) {
+        event_handler.handleEvent(cur_event);
+        queue.complete();
+      }
+    });
+  }
+  // critical events are useless after 2 seconds
+  const auto critical_timeout = std::chrono::seconds(2);
   for (size_t i = 0; i < num_tasks; ++i) {
-    auto cur_event = m_events[i];
-    tg.run([cur_event]() { event_handler.handleEvent(cur_event); });
+    if (m_events[i].priority == EventPriority::CRITICAL) {
+      m_events[i].deadline = Event::ClockTy::now() + critical_timeout;
+    }
+    queue.push(m_events[i]);
+  }
+  queue.close();
+  for (auto &&worker : workers) {
+    worker.join();
   }
-  tg.wait();
+  results_stream.close();
+  consumer.join();
 
   // hear all tasks must be completed
   std::cout << "Results count: " << results.size() << std::endl;
@@ -45,6 +115,21 @@ int main() {
   std::cout << "Newest slot: " << std::get<0>(results.top_newer()) << std::endl;
   std::cout << "Standard deviation: " << results.standard_deviation() << " ms"
             << std::endl;
+  std::cout << "Streamed results: " << streamed_count
+            << ", last slot: " << last_streamed_slot
+            << ", late: " << results_stream.late_count() << std::endl;
+
+  if (auto *adaptive =
+          dynamic_cast<AdaptiveRateController *>(limit_controller.get())) {
+    std::cout << "Rate limit: " << adaptive->rate() << " req/s, "
+              << adaptive->in_flight_limit() << " in flight" << std::endl;
+  }
+
+  auto &&queue_stats = queue.stats();
+  std::cout << "Queue: pushed " << queue_stats.pushed << ", dropped "
+            << queue_stats.dropped << ", coalesced " << queue_stats.coalesced
+            << ", expired " << queue_stats.expired << ", max depth "
+            << queue_stats.max_depth << std::endl;
 
   return 0;
 }
\ No newline at end of file